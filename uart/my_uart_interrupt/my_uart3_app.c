@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <poll.h>
 
 #define DEVICE "/dev/my_uart3"
 
@@ -22,7 +23,17 @@ int main() {
         return 1;
     }
 
-    usleep(100000);
+    // wait for the echo instead of guessing with usleep()
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int pr = poll(&pfd, 1, 1000);
+    if (pr <= 0) {
+        if (pr < 0)
+            perror("Poll failed");
+        else
+            printf("Recv : (timeout)\n");
+        close(fd);
+        return 1;
+    }
 
     // read
     int len = read(fd, recv, sizeof(recv) - 1);
@@ -4,27 +4,61 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/of.h>
+#include <linux/property.h>
+#include <linux/platform_device.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/clk.h>
+#include <linux/iopoll.h>
+#include <linux/crc-ccitt.h>
+#include <linux/hrtimer.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/irq.h>
+#include <uapi/linux/sched/types.h>
 
-#define DEVICE_NAME "my_uart3"
-#define UART3_BASE_PHYS 0xFE201600
-#define UART3_REG_SIZE  0x90
+#include "my_uart3_ioctl.h"
+#include "my_uart3_ring.h"
+
+#define CREATE_TRACE_POINTS
+#include "my_uart3_trace.h"
+
+#define DEVICE_NAME "my_uart"
+
+/*
+ * BCM2711 PL011 ports sit 0x200 apart from UART0 (0x7e201000), so the line
+ * number N of /dev/my_uartN falls out of the register base: UART3 at
+ * 0x7e201600 stays /dev/my_uart3.
+ */
+#define MY_UART_MAX_PORTS  6
+#define MY_UART_PORT_STRIDE 0x200
+#define MY_UART_LINE(start) (((start) & 0xfff) / MY_UART_PORT_STRIDE)
 
 /* ---- Clock / baud ---- */
-#define UARTCLK  48000000
+#define UARTCLK_DEFAULT 48000000	/* rpi4 firmware default, if DT has no "uartclk" */
 static int baudrate = 115200;
 module_param(baudrate, int, 0444);
-MODULE_PARM_DESC(baudrate, "UART baudrate (default 115200)");
-
-#define CALC_IBRD(baud) ((UARTCLK) / (16 * (baud)))
-#define CALC_FBRD(baud) ((((UARTCLK) % (16 * (baud))) * 64 + ((baud) / 2)) / (baud))
-static unsigned int ibrd;
-static unsigned int fbrd;
+MODULE_PARM_DESC(baudrate, "Initial UART baudrate (default 115200), see MY_UART_IOC_SET_LINE");
 
-/* ---- MMIO ---- */
-static void __iomem *uart3_base;
-static int major = -1;
+/* Drain timeout before a line change gives up */
+#define LINE_DRAIN_MS 2000
 
 /* ---- PL011 offsets ---- */
 #define UART_DR    0x00
@@ -38,8 +72,16 @@ static int major = -1;
 #define UART_RIS   0x3C
 #define UART_MIS   0x40
 #define UART_ICR   0x44
+#define UART_DMACR 0x48
+
+/* ---- DR bits: per-character receive errors ---- */
+#define UART_DR_FE (1 << 8)
+#define UART_DR_PE (1 << 9)
+#define UART_DR_BE (1 << 10)
+#define UART_DR_OE (1 << 11)
 
 /* ---- FR bits ---- */
+#define UART_FR_BUSY (1 << 3)
 #define UART_FR_TXFF (1 << 5)
 #define UART_FR_RXFE (1 << 4)
 
@@ -62,240 +104,3609 @@ static int major = -1;
 #define UART_CR_LBE    (1 << 7)   /* internal loopback */
 #define UART_CR_TXE    (1 << 8)
 #define UART_CR_RXE    (1 << 9)
+#define UART_CR_RTS    (1 << 11)  /* drive nRTS low (asserted) */
+#define UART_CR_RTSEN  (1 << 14)  /* hardware RTS from RX FIFO level */
+#define UART_CR_CTSEN  (1 << 15)  /* TX only while nCTS is asserted */
 
 /* ---- LCRH bits ---- */
-#define UART_LCRH_FEN    (1 << 4)
-#define UART_LCRH_WLEN_8 (3 << 5)
-
-/* ---- IFLS: RX/TX FIFO 1/2 ---- */
-#define UART_IFLS_HALF_RX (0x2 << 3)
-#define UART_IFLS_HALF_TX (0x2 << 0)
-
-/* ---- Simple ring buffer ---- */
-#define RB_SZ 1024 /* must be power of two */
-struct ring {
-	char buf[RB_SZ];
-	unsigned int head, tail;
-	spinlock_t lock;
-};
-static struct ring rxrb = { .lock = __SPIN_LOCK_UNLOCKED(rxrb.lock) };
-static struct ring txrb = { .lock = __SPIN_LOCK_UNLOCKED(txrb.lock) };
+#define UART_LCRH_PEN     (1 << 1)
+#define UART_LCRH_EPS     (1 << 2)
+#define UART_LCRH_STP2    (1 << 3)
+#define UART_LCRH_FEN     (1 << 4)
+#define UART_LCRH_WLEN(n) (((n) - 5) << 5)
+
+/* ---- DMACR bits ---- */
+#define UART_DMACR_RXDMAE (1 << 0)
+#define UART_DMACR_TXDMAE (1 << 1)
 
-static inline bool rb_empty(struct ring *r) { return r->head == r->tail; }
-static inline bool rb_full(struct ring *r)  { return ((r->head + 1) & (RB_SZ - 1)) == r->tail; }
-static inline void rb_put(struct ring *r, char c) { r->buf[r->head] = c; r->head = (r->head + 1) & (RB_SZ - 1); }
-static inline char rb_get(struct ring *r) { char c = r->buf[r->tail]; r->tail = (r->tail + 1) & (RB_SZ - 1); return c; }
+/* ---- IFLS: trigger level index 0..4 = 1/8, 1/4, 1/2, 3/4, 7/8 ---- */
+#define UART_IFLS_RX(lvl) ((lvl) << 3)
+#define UART_IFLS_TX(lvl) ((lvl) << 0)
+#define IFLS_HALF 2
 
-/* ---- IRQ ---- */
-#define UART3_IRQ_DEFAULT 50
-static int irq = UART3_IRQ_DEFAULT;
-module_param(irq, int, 0444);
-MODULE_PARM_DESC(irq, "UART3 IRQ number (default 50)");
+/* IFLS level index -> FIFO fill in eighths, as seen by sysfs/ioctl */
+static const u8 ifls_eighths[] = { 1, 2, 4, 6, 7 };
+
+/* ---- Adaptive RX trigger ---- */
+#define ADAPT_WINDOW_MS 50
+
+/* ---- SPSC ring buffer: see my_uart3_ring.h ---- */
+static unsigned int rx_ring_size = MY_UART_RING_MIN;
+module_param(rx_ring_size, uint, 0444);
+MODULE_PARM_DESC(rx_ring_size, "Initial RX ring bytes, power of two (default 1024), see MY_UART_IOC_SET_RING");
+static unsigned int tx_ring_size = MY_UART_RING_MIN;
+module_param(tx_ring_size, uint, 0444);
+MODULE_PARM_DESC(tx_ring_size, "Initial TX ring bytes, power of two (default 1024)");
+
+/*
+ * RX throttling water marks (rxrb fill). Above HIGH the ISR drops RTS; the
+ * remaining quarter of the ring absorbs what the peer still has in flight.
+ * read() raises RTS again once the reader has brought the fill under LOW.
+ */
+#define RX_HIGH_WATER(sz) ((sz) / 4 * 3)
+#define RX_LOW_WATER(sz)  ((sz) / 4)
 
 /* ---- Internal loopback toggle ---- */
 static bool loopback;
 module_param(loopback, bool, 0644);
 MODULE_PARM_DESC(loopback, "Enable PL011 internal loopback (default false)");
 
-static void uart_tx_kick(void)
+/*
+ * ---- Threaded IRQ (PREEMPT_RT) ----
+ * The hard handler only masks the sources that fired; a SCHED_FIFO thread
+ * drains the FIFO and unmasks. Keeps the shared GIC line short for the
+ * other UARTs at the cost of a thread wakeup per interrupt.
+ */
+static bool threaded_irq;
+module_param(threaded_irq, bool, 0444);
+MODULE_PARM_DESC(threaded_irq, "Drain the FIFO from an IRQ thread (default false)");
+static int irq_thread_prio;
+module_param(irq_thread_prio, int, 0444);
+MODULE_PARM_DESC(irq_thread_prio, "Initial SCHED_FIFO priority of the IRQ thread, 1..99 (default 0: kernel default)");
+
+/* ---- DMA (optional, dmaengine) ---- */
+static bool use_dma;
+module_param(use_dma, bool, 0444);
+MODULE_PARM_DESC(use_dma, "Use dmaengine for RX/TX, falls back to PIO (default false)");
+
+#define DMA_RX_BUF_SZ   4096	/* cyclic RX buffer */
+#define DMA_RX_PERIODS  4	/* callbacks per lap of the RX buffer */
+#define DMA_RX_POLL_MS  10	/* flush partial periods */
+#define DMA_MAXBURST    8	/* matches the 1/2 FIFO watermark */
+#define DMA_TX_SG_MAX   32	/* txrb pages per TX descriptor: 128 KiB with 4 KiB pages */
+
+struct uart_dma {
+	struct dma_chan *rx_chan;
+	struct dma_chan *tx_chan;
+
+	/* RX: one cyclic descriptor into a coherent buffer */
+	char *rx_buf;
+	dma_addr_t rx_addr;
+	dma_cookie_t rx_cookie;
+	unsigned int rx_pos;	/* next unread offset in rx_buf, under port rx_lock */
+	struct timer_list rx_poll;
+
+	/* TX: straight out of txrb, one sg entry per vmalloc page */
+	struct scatterlist tx_sg[DMA_TX_SG_MAX];
+	unsigned int tx_ents;	/* entries set up, and to unmap */
+	unsigned int tx_len;
+	bool tx_busy;		/* protected by tx_lock */
+};
+
+/* One writer per field (ISR, rx_lock or tx_lock holder); readers accept a torn value */
+struct my_uart_stats {
+	u64 isr_calls;
+	u64 rx_irqs;
+	u64 rt_irqs;
+	u64 tx_irqs;
+	u64 rx_bytes;
+	u64 tx_bytes;
+	u64 rx_dropped;		/* software: rxrb full */
+	u64 overrun_errs;	/* hardware: RX FIFO overflowed */
+	u64 frame_errs;
+	u64 parity_errs;
+	u64 break_errs;
+	u64 rx_throttles;	/* RTS dropped at the rxrb high-water mark */
+	u64 rx_frames;
+	u64 tx_frames;
+	u64 rx_crc_errs;
+	u64 rx_bad_frames;
+	u64 rx_dropped_frames;
+	u64 rx_ts_overflows;	/* batch not stamped, timestamp ring full */
+	u64 isr_max_ns;		/* longest drain (hard handler or IRQ thread) */
+	u64 irq_wake_max_ns;	/* threaded: longest hard IRQ to thread start */
+	/* Fan-out readers poll without a shared lock: the one multi-writer pair */
+	atomic64_t busy_polls;	/* all files, see struct my_uart_file */
+	atomic64_t busy_poll_hits;
+	unsigned int rx_high_water;	/* max rxrb fill seen by the ISR */
+	unsigned int tx_high_water;	/* max txrb fill seen by the TX kick */
+};
+
+/*
+ * ---- SLIP framing (RFC 1055) ----
+ * Wire: END, payload + CRC-16/X.25 (LSB first) with END/ESC escaped, END.
+ * In rxrb each good frame is a record: 16-bit little-endian payload length
+ * followed by the payload, published in one go so read() sees whole frames.
+ */
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+#define FRAME_CRC_LEN 2
+#define FRAME_HDR_LEN 2
+/* Every byte escaped, plus both ENDs */
+#define FRAME_ENC_MAX (2 * (MY_UART_FRAME_MAX + FRAME_CRC_LEN) + 2)
+
+/* RX decoder, under rx_lock */
+struct frame_rx {
+	u8 buf[MY_UART_FRAME_MAX + FRAME_CRC_LEN];
+	unsigned int len;
+	u8 mode;	/* framing this state was built for */
+	bool esc;
+	bool bad;	/* skip to the next END */
+};
+
+/*
+ * ---- RX timestamp ring ----
+ * One entry per drained batch: rxrb index of its first byte and the time.
+ * SPSC like struct ring: the RX producer (under rx_lock) adds, read()
+ * (under rxrb.user) drops entries once their bytes have been consumed.
+ */
+#define TS_RING_SZ 256 /* must be power of two */
+struct ts_ring {
+	struct {
+		unsigned int pos;
+		u64 ns;
+	} ent[TS_RING_SZ];
+	unsigned int head;
+	unsigned int tail;
+};
+
+/*
+ * ---- RX error bit-planes ----
+ * One bitmap per DR error bit, indexed like rxrb slots, plus a summary
+ * plane. Only the RX producer writes them, and only for a byte that has an
+ * error or lands on a slot that had one, so clean traffic costs one
+ * test_bit() per byte. Bit i of a MY_UART_ERR_* value is plane i.
+ */
+#define RX_ERR_PLANES 4
+#define RX_ERR_ANY    RX_ERR_PLANES
+#define DR_ERR_SHIFT  8
+
+/* log2 histograms: bucket i counts values in [2^(i-1), 2^i), bucket 0 counts zero */
+#define HIST_BUCKETS 24
+struct my_uart_hist {
+	u32 isr_ns[HIST_BUCKETS];
+	u32 irq_wake_ns[HIST_BUCKETS];	/* threaded: hard IRQ to thread start */
+	u32 bytes_per_isr[HIST_BUCKETS];
+	u32 rx_fill[HIST_BUCKETS];	/* rxrb fill after each RX drain */
+	u32 tx_fill[HIST_BUCKETS];	/* txrb fill before each TX kick */
+};
+
+static inline void hist_add(u32 *hist, u64 val)
+{
+	hist[min_t(unsigned int, fls64(val), HIST_BUCKETS - 1)]++;
+}
+
+/* ---- Per-port state ---- */
+struct my_uart_port {
+	struct device *dev;
+	void __iomem *base;
+	resource_size_t mapbase;
+	int irq;
+	unsigned int line;	/* N in /dev/my_uartN */
+	struct cdev cdev;
+	/* /dev/my_uartN; its refcount (open files via cdev, VMAs) owns this struct */
+	struct device cdev_dev;
+
+	/* Line settings; cfg_lock orders open() against MY_UART_IOC_SET_LINE */
+	struct mutex cfg_lock;
+	unsigned int open_count;	/* under cfg_lock; the UART runs while non-zero */
+	bool dead;		/* set under cfg_lock by my_uart_remove(), see my_uart_dead() */
+	struct clk *clk;
+	unsigned long uartclk;
+	struct my_uart_line_cfg line_cfg;
+	unsigned int ibrd;
+	unsigned int fbrd;
+
+	/*
+	 * Read-modify-write of CR and the IFLS trigger configuration, plus the
+	 * RX stall/throttle state, shared by ioctl/sysfs, read() and the ISR
+	 */
+	spinlock_t lock;
+	u8 rx_ifls;		/* IFLS level index, see ifls_eighths[] */
+	u8 tx_ifls;
+	bool adaptive_rx;
+	unsigned long adapt_start;	/* jiffies at start of the current window */
+	struct my_uart_stats adapt_base;	/* stats snapshot at that point */
+
+	/*
+	 * IMSC as the driver wants it. The threaded hard handler holds back
+	 * what fired (irq_masked) until the thread has run; raw, as that
+	 * handler stays in hard IRQ context even on PREEMPT_RT.
+	 */
+	raw_spinlock_t irq_lock;
+	u32 imsc;
+	u32 irq_masked;
+	u64 irq_hard_ns;	/* when the hard handler last woke the thread */
+	bool threaded;
+
+	/* IRQ thread scheduling; the thread applies it itself on its next run */
+	struct mutex thread_lock;
+	int thread_prio;	/* SCHED_FIFO, 0: kernel default */
+	cpumask_t thread_cpus;	/* empty: follow the IRQ affinity */
+	atomic_t thread_setup;	/* settings changed since the thread last looked */
+
+	/* RX flow control state, under lock */
+	bool rx_throttled;	/* RTS dropped, rxrb above the high-water mark */
+	bool rx_stalled;	/* PIO: rxrb full, RX interrupts masked, data left in the FIFO */
+
+	struct my_uart_stats stats;
+	struct my_uart_hist hist;
+	struct dentry *debugfs;
+
+	struct ring rxrb;
+	struct ring txrb;
+	u8 rx_overflow;		/* MY_UART_OVERFLOW_*, see my_uart_rx_char() */
+	/* MY_UART_IOC_SET_FANOUT; flipped under rxrb.user and rx_lock */
+	bool fanout;
+	/* Bumped under rxrb.user whenever rxrb is emptied or reset: fan-out cursors resync */
+	unsigned int rx_gen;
+	u64 rx_last_ns;		/* last RX drain that moved data, for VTIME; under rx_lock */
+	struct my_uart_mmap_ctrl *ctrl;	/* ring indices, shared by mmap() */
+	atomic_t mmap_count;	/* live VMAs; read()/write() are off while non-zero */
+	/* Serialises the RX producer (ISR drain, DMA callback/poll timer, idle timer) */
+	spinlock_t rx_lock;
+	/* Serialises the TX consumer (PIO kick from ISR/write, DMA kick/callback) */
+	spinlock_t tx_lock;
+	/* Readers sleep on rx_wq until the ISR fills rxrb, writers on tx_wq until txrb drains */
+	wait_queue_head_t rx_wq;
+	wait_queue_head_t tx_wq;
+
+	struct uart_dma dma;
+	bool dma_active;
+
+	/* MY_UART_FRAMING_*; changed with both ring mutexes held */
+	u8 framing;
+	struct frame_rx frx;
+	/* MY_UART_FRAMING_IDLE: a burst ends when idle_timer expires undisturbed */
+	struct hrtimer idle_timer;
+	ktime_t idle_deadline;	/* under rx_lock */
+	u32 idle_gap_us;	/* 0: Modbus RTU t3.5 for the current line settings */
+
+	bool rx_ts_on;		/* MY_UART_IOC_SET_RX_TS */
+	struct ts_ring rx_ts;
+
+	unsigned long *rx_err[RX_ERR_PLANES + 1];	/* rxrb.size bits each, one vzalloc() */
+	u8 tx_frame[MY_UART_FRAME_MAX + FRAME_CRC_LEN];	/* write() scratch, under txrb.user */
+};
+
+/* ---- Per-open state ---- */
+struct my_uart_file {
+	struct my_uart_port *port;
+	u32 busy_poll_us;	/* MY_UART_IOC_SET_BUSY_POLL */
+	/* Written by read() */
+	u64 busy_polls;
+	u64 busy_poll_hits;
+	u64 busy_poll_drained;
+
+	/* Fan-out: this file's rxrb consumer index, under rxrb.user */
+	unsigned int rx_pos;
+	unsigned int rx_gen;	/* port->rx_gen rx_pos belongs to */
+	u64 rx_overruns;
+	u64 rx_lost;
+
+	/* MY_UART_IOC_SET_WAKE */
+	u32 vmin;
+	u32 vtime_us;
+	int eol;		/* delimiter, -1: none */
+};
+
+static dev_t my_uart_devt;
+static struct class *my_uart_class;
+static struct dentry *my_uart_debugfs_root;
+
+/*
+ * Unbound while files were still open: the registers are gone, only
+ * release() still does anything. Sleepers are woken to see it.
+ */
+static inline bool my_uart_dead(struct my_uart_port *port)
+{
+	return READ_ONCE(port->dead);
+}
+
+static void uart_dma_tx_kick(struct my_uart_port *port);
+static void my_uart_idle_arm(struct my_uart_port *port, bool rtim);
+
+/* IMSC goes through the shadow so the threaded top half's mask survives */
+static void my_uart_imsc(struct my_uart_port *port, u32 clear, u32 set)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&port->irq_lock, flags);
+	port->imsc = (port->imsc & ~clear) | set;
+	writel(port->imsc & ~port->irq_masked, port->base + UART_IMSC);
+	raw_spin_unlock_irqrestore(&port->irq_lock, flags);
+}
+
+/* ---- RTS/CTS flow control ---- */
+static inline bool my_uart_flow(struct my_uart_port *port)
+{
+	return port->line_cfg.flow == MY_UART_FLOW_RTSCTS;
+}
+
+/* CR for a running port: enables, loopback and flow control */
+static u32 my_uart_cr(struct my_uart_port *port)
+{
+	u32 cr = UART_CR_UARTEN | UART_CR_TXE | UART_CR_RXE;
+
+	if (loopback)
+		cr |= UART_CR_LBE;
+	if (my_uart_flow(port))
+		cr |= UART_CR_RTS | UART_CR_RTSEN | UART_CR_CTSEN;
+	return cr;
+}
+
+/*
+ * After an RX drain: drop RTS once rxrb crosses the high-water mark. RTSEn
+ * alone only reacts to the 32-byte FIFO, so it has to go too, or the
+ * hardware would keep nRTS asserted as long as the ISR empties the FIFO.
+ */
+static void my_uart_rx_throttle(struct my_uart_port *port)
+{
+	unsigned long flags;
+
+	/* Fan-out keeps rxrb full of history; only the FIFO level (RTSEn) counts */
+	if (!my_uart_flow(port) || READ_ONCE(port->fanout) ||
+	    rb_fill(&port->rxrb) < RX_HIGH_WATER(port->rxrb.size))
+		return;
+
+	spin_lock_irqsave(&port->lock, flags);
+	if (!port->rx_throttled) {
+		port->rx_throttled = true;
+		port->stats.rx_throttles++;
+		writel(readl(port->base + UART_CR) & ~(UART_CR_RTS | UART_CR_RTSEN),
+		       port->base + UART_CR);
+	}
+	spin_unlock_irqrestore(&port->lock, flags);
+}
+
+/* PIO, MY_UART_OVERFLOW_BLOCK: rxrb is full, leave the rest in the FIFO */
+static void my_uart_rx_stall(struct my_uart_port *port)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->lock, flags);
+	port->rx_stalled = true;
+	my_uart_imsc(port, UART_IMSC_RXIM | UART_IMSC_RTIM, 0);
+	spin_unlock_irqrestore(&port->lock, flags);
+}
+
+/* From read(): the reader has caught up, let the peer send again */
+static void my_uart_rx_unthrottle(struct my_uart_port *port)
 {
 	unsigned long flags;
 
-	spin_lock_irqsave(&txrb.lock, flags);
+	if (!READ_ONCE(port->rx_throttled) && !READ_ONCE(port->rx_stalled))
+		return;
+	if (rb_fill(&port->rxrb) > RX_LOW_WATER(port->rxrb.size))
+		return;
+
+	spin_lock_irqsave(&port->lock, flags);
+	if (my_uart_dead(port))
+		goto out;
+	if (port->rx_stalled) {
+		/* The FIFO still holds data, so this fires straight away */
+		port->rx_stalled = false;
+		my_uart_imsc(port, 0, UART_IMSC_RXIM | UART_IMSC_RTIM);
+	}
+	if (port->rx_throttled) {
+		port->rx_throttled = false;
+		writel(readl(port->base + UART_CR) | UART_CR_RTS | UART_CR_RTSEN,
+		       port->base + UART_CR);
+	}
+out:
+	spin_unlock_irqrestore(&port->lock, flags);
+}
+
+static void uart_tx_kick(struct my_uart_port *port)
+{
+	struct ring *txrb = &port->txrb;
+	unsigned int fill, sent = 0;
+	unsigned long flags;
+
+	if (port->dma_active) {
+		uart_dma_tx_kick(port);
+		return;
+	}
+
+	spin_lock_irqsave(&port->tx_lock, flags);
+	/* my_uart_remove() syncs with tx_lock after setting dead */
+	if (my_uart_dead(port)) {
+		spin_unlock_irqrestore(&port->tx_lock, flags);
+		return;
+	}
+
+	fill = rb_avail(txrb);
+	hist_add(port->hist.tx_fill, fill);
+	if (fill > port->stats.tx_high_water)
+		port->stats.tx_high_water = fill;
 
 	/* Push as much as possible into HW FIFO */
-	while (!rb_empty(&txrb) && !(readl(uart3_base + UART_FR) & UART_FR_TXFF))
-		writel(rb_get(&txrb), uart3_base + UART_DR);
+	while (!rb_empty(txrb) && !(readl(port->base + UART_FR) & UART_FR_TXFF)) {
+		writel(rb_get(txrb), port->base + UART_DR);
+		sent++;
+	}
+	port->stats.tx_bytes += sent;
+	trace_my_uart_tx_kick(port->line, sent, fill - sent);
 
 	/* Arm or disarm TX interrupt based on pending data */
-	if (!rb_empty(&txrb))
-		writel(readl(uart3_base + UART_IMSC) | UART_IMSC_TXIM, uart3_base + UART_IMSC);
+	if (!rb_empty(txrb))
+		my_uart_imsc(port, 0, UART_IMSC_TXIM);
 	else
-		writel(readl(uart3_base + UART_IMSC) & ~UART_IMSC_TXIM, uart3_base + UART_IMSC);
+		my_uart_imsc(port, UART_IMSC_TXIM, 0);
+
+	spin_unlock_irqrestore(&port->tx_lock, flags);
 
-	spin_unlock_irqrestore(&txrb.lock, flags);
+	if (sent)
+		wake_up_interruptible(&port->tx_wq);
 }
 
-static irqreturn_t my_uart3_isr(int irqno, void *dev_id)
+/* ---- SLIP framing: RX decoder ---- */
+static inline bool my_uart_framed(struct my_uart_port *port)
 {
-	u32 mis = readl(uart3_base + UART_MIS);
-	bool handled = false;
+	return READ_ONCE(port->framing) != MY_UART_FRAMING_NONE;
+}
 
-	/* RX or timeout */
-	if (mis & (UART_IMSC_RXIM | UART_IMSC_RTIM)) {
-		unsigned long flags;
-		spin_lock_irqsave(&rxrb.lock, flags);
-		while (!(readl(uart3_base + UART_FR) & UART_FR_RXFE)) {
-			char c = readl(uart3_base + UART_DR) & 0xFF;
-			if (!rb_full(&rxrb))
-				rb_put(&rxrb, c);
-		}
-		spin_unlock_irqrestore(&rxrb.lock, flags);
+/* Producer side: the whole record becomes visible at once, or nothing does */
+static bool rb_put_record(struct ring *r, const u8 *data, unsigned int len)
+{
+	unsigned int i, h = r->ix->head;
 
-		/* Clear RX-related sources and error latches */
-		writel(UART_ICR_RXIC | UART_ICR_RTIC |
-		       UART_ICR_FEIC | UART_ICR_PEIC | UART_ICR_BEIC | UART_ICR_OEIC,
-		       uart3_base + UART_ICR);
-		handled = true;
+	if (rb_space(r) < FRAME_HDR_LEN + len)
+		return false;
+	r->buf[rb_off(r, h++)] = len & 0xFF;
+	r->buf[rb_off(r, h++)] = len >> 8;
+	for (i = 0; i < len; i++)
+		r->buf[rb_off(r, h++)] = data[i];
+	smp_store_release(&r->ix->head, h);
+	return true;
+}
+
+/* Fan-out never holds the producer up: the oldest data goes, whatever rx_overflow says */
+static inline u8 my_uart_rx_overflow(struct my_uart_port *port)
+{
+	if (READ_ONCE(port->fanout))
+		return MY_UART_OVERFLOW_DROP_OLDEST;
+	return READ_ONCE(port->rx_overflow);
+}
+
+/* Under rx_lock: queue one frame, making room first under DROP_OLDEST */
+static bool my_uart_rx_record(struct my_uart_port *port, const u8 *data, unsigned int len)
+{
+	struct ring *r = &port->rxrb;
+	unsigned int t, old;
+
+	while (my_uart_rx_overflow(port) == MY_UART_OVERFLOW_DROP_OLDEST &&
+	       rb_space(r) < FRAME_HDR_LEN + len) {
+		t = smp_load_acquire(&r->ix->tail);
+		old = (u8)r->buf[rb_off(r, t)] | (u8)r->buf[rb_off(r, t + 1)] << 8;
+		if (FRAME_HDR_LEN + old > rb_fill(r))
+			break;	/* not a record boundary; leave it to read() to resync */
+		/* Fan-out: recycling history, the readers count their own losses */
+		if (cmpxchg(&r->ix->tail, t, t + FRAME_HDR_LEN + old) == t && !port->fanout)
+			port->stats.rx_dropped_frames++;
 	}
+	return rb_put_record(r, data, len);
+}
 
-	/* TX FIFO space available */
-	if (mis & UART_IMSC_TXIM) {
-		uart_tx_kick();
-		writel(UART_ICR_TXIC, uart3_base + UART_ICR);
-		handled = true;
+static u16 my_uart_frame_crc(const u8 *data, unsigned int len)
+{
+	return crc_ccitt(0xFFFF, data, len) ^ 0xFFFF;
+}
+
+static void my_uart_frame_end(struct my_uart_port *port)
+{
+	struct frame_rx *f = &port->frx;
+	unsigned int len;
+	u16 crc;
+
+	if (f->bad || f->esc || f->len <= FRAME_CRC_LEN) {
+		port->stats.rx_bad_frames++;
+		return;
+	}
+
+	len = f->len - FRAME_CRC_LEN;
+	crc = my_uart_frame_crc(f->buf, len);
+	if (f->buf[len] != (crc & 0xFF) || f->buf[len + 1] != crc >> 8) {
+		port->stats.rx_crc_errs++;
+		return;
 	}
 
-	return handled ? IRQ_HANDLED : IRQ_NONE;
+	if (!my_uart_rx_record(port, f->buf, len)) {
+		port->stats.rx_dropped_frames++;
+		return;
+	}
+	port->stats.rx_frames++;
 }
 
-/* ---- Char device fops ---- */
-static int my_uart3_open(struct inode *inode, struct file *file)
+static void my_uart_frame_rx(struct my_uart_port *port, u8 c)
 {
-	u32 cr;
+	struct frame_rx *f = &port->frx;
 
-	/* Disable and clear */
-	writel(0x0,  uart3_base + UART_CR);
-	writel(0x7FF, uart3_base + UART_ICR);
-
-	/* Program baud and framing */
-	ibrd = CALC_IBRD(baudrate);
-	fbrd = CALC_FBRD(baudrate);
-	writel(ibrd, uart3_base + UART_IBRD);
-	writel(fbrd, uart3_base + UART_FBRD);
-	writel(UART_LCRH_FEN | UART_LCRH_WLEN_8, uart3_base + UART_LCRH);
-	writel(UART_IFLS_HALF_RX | UART_IFLS_HALF_TX, uart3_base + UART_IFLS);
-
-	/* Enable RX + RX timeout interrupts now; TXIM is armed on demand */
-	writel(UART_IMSC_RXIM | UART_IMSC_RTIM, uart3_base + UART_IMSC);
-
-	/* Enable with optional internal loopback */
-	cr = UART_CR_UARTEN | UART_CR_TXE | UART_CR_RXE;
-	if (loopback)
-		cr |= UART_CR_LBE;
-	writel(cr, uart3_base + UART_CR);
+	if (c == SLIP_END) {
+		/* Back-to-back ENDs are idle fill, not empty frames */
+		if (f->len || f->bad)
+			my_uart_frame_end(port);
+		f->len = 0;
+		f->esc = false;
+		f->bad = false;
+		return;
+	}
+	if (f->bad)
+		return;
 
-	pr_info("my_uart3: configured %d 8N1\n",
-		baudrate);
-	return 0;
+	if (f->esc) {
+		f->esc = false;
+		if (c == SLIP_ESC_END) {
+			c = SLIP_END;
+		} else if (c == SLIP_ESC_ESC) {
+			c = SLIP_ESC;
+		} else {
+			f->bad = true;
+			return;
+		}
+	} else if (c == SLIP_ESC) {
+		f->esc = true;
+		return;
+	}
+
+	if (f->len == sizeof(f->buf)) {
+		f->bad = true;
+		return;
+	}
+	f->buf[f->len++] = c;
 }
 
-static ssize_t my_uart3_write(struct file *file, const char __user *buf,
-			      size_t count, loff_t *ppos)
+/* Producer side: record the MY_UART_ERR_* flags of the byte about to go in at pos */
+static inline void my_uart_rx_err_mark(struct my_uart_port *port, unsigned int pos, u8 flags)
 {
-	size_t i;
-	unsigned long flags;
-	char ch;
+	unsigned int slot = rb_off(&port->rxrb, pos);
+	int i;
 
-	for (i = 0; i < count; i++) {
-		if (copy_from_user(&ch, buf + i, 1))
-			return i ? i : -EFAULT;
+	if (likely(!flags) && !test_bit(slot, port->rx_err[RX_ERR_ANY]))
+		return;
+	for (i = 0; i < RX_ERR_PLANES; i++)
+		__assign_bit(slot, port->rx_err[i], flags & BIT(i));
+	__assign_bit(slot, port->rx_err[RX_ERR_ANY], flags);
+}
 
-		spin_lock_irqsave(&txrb.lock, flags);
-		if (rb_full(&txrb)) {
-			spin_unlock_irqrestore(&txrb.lock, flags);
+/*
+ * One received byte, from the PIO drain or the DMA drain, under rx_lock.
+ * flags are MY_UART_ERR_*; DMA transfers only the data byte, so always 0.
+ */
+static void my_uart_rx_char(struct my_uart_port *port, u8 c, u8 flags)
+{
+	u8 mode = READ_ONCE(port->framing);
 
-			/* Try direct push if HW FIFO not full */
-			if (!(readl(uart3_base + UART_FR) & UART_FR_TXFF)) {
-				writel(ch, uart3_base + UART_DR);
-				continue;
+	if (unlikely(mode != port->frx.mode)) {
+		/* MY_UART_IOC_SET_FRAMING: restart the decoder in the new mode */
+		port->frx.len = 0;
+		port->frx.esc = false;
+		port->frx.bad = false;
+		port->frx.mode = mode;
+	}
+
+	if (mode == MY_UART_FRAMING_SLIP) {
+		my_uart_frame_rx(port, c);
+	} else if (mode == MY_UART_FRAMING_IDLE) {
+		/* Whatever arrives until the line goes quiet, verbatim */
+		if (port->frx.len < MY_UART_FRAME_MAX)
+			port->frx.buf[port->frx.len++] = c;
+		else
+			port->frx.bad = true;
+	} else {
+		if (rb_full(&port->rxrb)) {
+			if (my_uart_rx_overflow(port) != MY_UART_OVERFLOW_DROP_OLDEST) {
+				port->stats.rx_dropped++;
+				return;
 			}
-			/* Non-blocking: stop here */
-			break;
-		} else {
-			rb_put(&txrb, ch);
-			spin_unlock_irqrestore(&txrb.lock, flags);
+			if (!port->fanout)
+				port->stats.rx_dropped++;
+			rb_drop(&port->rxrb, 1);
 		}
+		my_uart_rx_err_mark(port, port->rxrb.ix->head, flags);
+		rb_put(&port->rxrb, c);
 	}
+}
+
+/*
+ * MY_UART_OVERFLOW_BLOCK: hold RX back in the hardware rather than drop it.
+ * Under DMA the cyclic transfer keeps filling rx_buf regardless and would
+ * silently lap it, so there BLOCK is only allowed with RTS/CTS
+ * (my_uart_block_ok()).
+ */
+static inline bool my_uart_rx_block(struct my_uart_port *port)
+{
+	return my_uart_rx_overflow(port) == MY_UART_OVERFLOW_BLOCK;
+}
+
+/* BLOCK: could the next byte be lost for want of rxrb space? */
+static bool my_uart_rx_room(struct my_uart_port *port)
+{
+	if (my_uart_framed(port))
+		return rb_space(&port->rxrb) >= FRAME_HDR_LEN + MY_UART_FRAME_MAX;
+	return !rb_full(&port->rxrb);
+}
+
+/* Under rx_lock, after a drain: stamp the bytes it put into rxrb from pos on */
+static void my_uart_rx_ts_put(struct my_uart_port *port, unsigned int pos, u64 ns)
+{
+	struct ts_ring *tr = &port->rx_ts;
+
+	if (!READ_ONCE(port->rx_ts_on) || port->rxrb.ix->head == pos)
+		return;
+	if (tr->head - smp_load_acquire(&tr->tail) == TS_RING_SZ) {
+		port->stats.rx_ts_overflows++;
+		return;
+	}
+	tr->ent[tr->head & (TS_RING_SZ - 1)].pos = pos;
+	tr->ent[tr->head & (TS_RING_SZ - 1)].ns = ns;
+	smp_store_release(&tr->head, tr->head + 1);
+}
+
+/* ---- DMA engine ---- */
+static struct device *uart_dma_dev(struct dma_chan *chan)
+{
+	return chan->device->dev;
+}
+
+static void uart_dma_tx_callback(void *param)
+{
+	struct my_uart_port *port = param;
+	struct uart_dma *dma = &port->dma;
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->tx_lock, flags);
+	dma_unmap_sg(uart_dma_dev(dma->tx_chan), dma->tx_sg, dma->tx_ents, DMA_TO_DEVICE);
+	smp_store_release(&port->txrb.ix->tail, port->txrb.ix->tail + dma->tx_len);
+	port->stats.tx_bytes += dma->tx_len;
+	dma->tx_busy = false;
+	spin_unlock_irqrestore(&port->tx_lock, flags);
+
+	wake_up_interruptible(&port->tx_wq);
 
-	uart_tx_kick();
-	return i;
+	/* Chain the next batch if writers queued more meanwhile */
+	uart_dma_tx_kick(port);
 }
 
-static ssize_t my_uart3_read(struct file *file, char __user *buf,
-			     size_t count, loff_t *ppos)
+static void uart_dma_tx_kick(struct my_uart_port *port)
 {
-	char kbuf[128];
-	size_t i = 0;
+	struct uart_dma *dma = &port->dma;
+	struct ring *txrb = &port->txrb;
+	struct dma_async_tx_descriptor *desc;
+	struct device *dev;
+	unsigned int fill, len, seg, off, n;
 	unsigned long flags;
+	int mapped;
+	char *p;
+
+	spin_lock_irqsave(&port->tx_lock, flags);
+	fill = rb_avail(txrb);
+	if (dma->tx_busy || !fill || my_uart_dead(port))
+		goto out;
+	/* Not before the dead check: uart_dma_release() clears tx_chan */
+	dev = uart_dma_dev(dma->tx_chan);
+
+	hist_add(port->hist.tx_fill, fill);
+	if (fill > port->stats.tx_high_water)
+		port->stats.tx_high_water = fill;
+
+	/*
+	 * Map [tail, head) in place. The producer only advances head and the
+	 * tail stays put until the completion callback, so the mapped bytes are
+	 * stable for the lifetime of the transfer.
+	 *
+	 * vmalloc pages are not contiguous: one sg entry per page, carrying on
+	 * from the start of buf at the wrap, so a single descriptor covers the
+	 * whole fill up to DMA_TX_SG_MAX pages. The callback chains the rest.
+	 */
+	sg_init_table(dma->tx_sg, DMA_TX_SG_MAX);
+	for (n = 0, len = 0; n < DMA_TX_SG_MAX && len < fill; n++, len += seg) {
+		off = rb_off(txrb, txrb->ix->tail + len);
+		p = txrb->buf + off;
+		seg = min3(fill - len, txrb->size - off,
+			   (unsigned int)(PAGE_SIZE - offset_in_page(p)));
+		sg_set_page(&dma->tx_sg[n], vmalloc_to_page(p), seg, offset_in_page(p));
+	}
+	sg_mark_end(&dma->tx_sg[n - 1]);
+	dma->tx_ents = n;
+	dma->tx_len = len;
+	/* Same meaning as the PIO kick: sent now, left in txrb */
+	trace_my_uart_tx_kick(port->line, len, fill - len);
 
-	if (count > sizeof(kbuf))
-		count = sizeof(kbuf);
+	mapped = dma_map_sg(dev, dma->tx_sg, n, DMA_TO_DEVICE);
+	if (!mapped)
+		goto out;
+
+	desc = dmaengine_prep_slave_sg(dma->tx_chan, dma->tx_sg, mapped,
+				       DMA_MEM_TO_DEV,
+				       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		dma_unmap_sg(dev, dma->tx_sg, n, DMA_TO_DEVICE);
+		goto out;
+	}
+
+	desc->callback = uart_dma_tx_callback;
+	desc->callback_param = port;
+	dma->tx_busy = true;
+	dmaengine_submit(desc);
+	dma_async_issue_pending(dma->tx_chan);
+out:
+	spin_unlock_irqrestore(&port->tx_lock, flags);
+}
+
+/* Account the rxrb fill level after a producer batch */
+static void my_uart_rx_fill_sample(struct my_uart_port *port)
+{
+	unsigned int fill = port->rxrb.ix->head - READ_ONCE(port->rxrb.ix->tail);
+
+	hist_add(port->hist.rx_fill, fill);
+	if (fill > port->stats.rx_high_water)
+		port->stats.rx_high_water = fill;
+}
 
-	spin_lock_irqsave(&rxrb.lock, flags);
-	while (i < count && !rb_empty(&rxrb))
-		kbuf[i++] = rb_get(&rxrb);
-	spin_unlock_irqrestore(&rxrb.lock, flags);
+/*
+ * Move everything the cyclic RX transfer has written since last time into
+ * rxrb. Returns the number of bytes taken from the DMA buffer. Callback,
+ * poll timer, RX timeout and idle timer can race, so sample under rx_lock.
+ */
+static unsigned int __uart_dma_rx_drain(struct my_uart_port *port)
+{
+	struct uart_dma *dma = &port->dma;
+	struct dma_tx_state state;
+	unsigned int pos, n = 0;
+	unsigned int head = port->rxrb.ix->head;
+	u64 ns = ktime_get_ns();
 
-	if (i == 0)
+	if (dmaengine_tx_status(dma->rx_chan, dma->rx_cookie, &state) == DMA_ERROR)
 		return 0;
-	if (copy_to_user(buf, kbuf, i))
-		return -EFAULT;
-	return i;
+
+	pos = DMA_RX_BUF_SZ - state.residue;
+	if (pos >= DMA_RX_BUF_SZ)
+		pos = 0;
+
+	while (dma->rx_pos != pos) {
+		if (my_uart_rx_block(port) && !my_uart_rx_room(port))
+			break;	/* keep the rest in rx_buf until read() makes room */
+		my_uart_rx_char(port, dma->rx_buf[dma->rx_pos], 0);
+		dma->rx_pos = (dma->rx_pos + 1) & (DMA_RX_BUF_SZ - 1);
+		n++;
+	}
+	port->stats.rx_bytes += n;
+	if (n) {
+		WRITE_ONCE(port->rx_last_ns, ns);
+		my_uart_rx_ts_put(port, head, ns);
+		my_uart_rx_fill_sample(port);
+		trace_my_uart_rx_put(port->line, n, rb_fill(&port->rxrb));
+		if (port->frx.mode == MY_UART_FRAMING_IDLE)
+			my_uart_idle_arm(port, false);
+	}
+	return n;
 }
 
-static int my_uart3_release(struct inode *inode, struct file *file)
+static unsigned int uart_dma_rx_drain(struct my_uart_port *port)
+{
+	unsigned long flags;
+	unsigned int n;
+
+	spin_lock_irqsave(&port->rx_lock, flags);
+	/* Dead: uart_dma_release() may have dropped the channel and rx_buf */
+	n = my_uart_dead(port) ? 0 : __uart_dma_rx_drain(port);
+	spin_unlock_irqrestore(&port->rx_lock, flags);
+
+	if (n) {
+		my_uart_rx_throttle(port);
+		wake_up_interruptible(&port->rx_wq);
+	}
+	return n;
+}
+
+static void uart_dma_rx_callback(void *param)
+{
+	uart_dma_rx_drain(param);
+}
+
+static void uart_dma_rx_poll(struct timer_list *t)
+{
+	struct my_uart_port *port = from_timer(port, t, dma.rx_poll);
+
+	uart_dma_rx_drain(port);
+	mod_timer(&port->dma.rx_poll, jiffies + msecs_to_jiffies(DMA_RX_POLL_MS));
+}
+
+static int uart_dma_rx_start(struct my_uart_port *port)
 {
-	/* Nothing special; leave HW enabled until module unload */
+	struct uart_dma *dma = &port->dma;
+	struct dma_async_tx_descriptor *desc;
+
+	desc = dmaengine_prep_dma_cyclic(dma->rx_chan, dma->rx_addr, DMA_RX_BUF_SZ,
+					 DMA_RX_BUF_SZ / DMA_RX_PERIODS,
+					 DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = uart_dma_rx_callback;
+	desc->callback_param = port;
+	dma->rx_pos = 0;
+	dma->rx_cookie = dmaengine_submit(desc);
+	if (dma_submit_error(dma->rx_cookie))
+		return -EIO;
+	dma_async_issue_pending(dma->rx_chan);
+	/* rx_poll runs while the port is open, see my_uart_startup() */
 	return 0;
 }
 
-static const struct file_operations my_uart3_fops = {
-	.owner   = THIS_MODULE,
-	.open    = my_uart3_open,
-	.read    = my_uart3_read,
-	.write   = my_uart3_write,
-	.release = my_uart3_release,
-};
+static void uart_dma_release(struct my_uart_port *port)
+{
+	struct uart_dma *dma = &port->dma;
 
-/* ---- Module init/exit ---- */
-static int __init my_uart3_init(void)
+	port->dma_active = false;
+	if (dma->rx_chan) {
+		timer_delete_sync(&dma->rx_poll);
+		dmaengine_terminate_sync(dma->rx_chan);
+		if (dma->rx_buf)
+			dma_free_coherent(uart_dma_dev(dma->rx_chan), DMA_RX_BUF_SZ,
+					  dma->rx_buf, dma->rx_addr);
+		dma_release_channel(dma->rx_chan);
+	}
+	if (dma->tx_chan) {
+		dmaengine_terminate_sync(dma->tx_chan);
+		if (dma->tx_busy)
+			dma_unmap_sg(uart_dma_dev(dma->tx_chan), dma->tx_sg, dma->tx_ents,
+				     DMA_TO_DEVICE);
+		dma_release_channel(dma->tx_chan);
+	}
+	memset(dma, 0, sizeof(*dma));
+}
+
+/*
+ * Channels come from the "dmas"/"dma-names" of the port's DT node (see
+ * my_uart3_custom.dts). Any failure leaves the PIO path in use.
+ */
+static int uart_dma_setup(struct my_uart_port *port)
 {
+	struct uart_dma *dma = &port->dma;
+	struct dma_slave_config rx_cfg = {
+		.direction      = DMA_DEV_TO_MEM,
+		.src_addr       = port->mapbase + UART_DR,
+		.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+		.src_maxburst   = DMA_MAXBURST,
+	};
+	struct dma_slave_config tx_cfg = {
+		.direction      = DMA_MEM_TO_DEV,
+		.dst_addr       = port->mapbase + UART_DR,
+		.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+		.dst_maxburst   = DMA_MAXBURST,
+	};
+	struct dma_chan *chan;
 	int ret;
 
-	if (irq < 0 || baudrate <= 0)
-		return -EINVAL;
+	timer_setup(&dma->rx_poll, uart_dma_rx_poll, 0);
 
-	major = register_chrdev(0, DEVICE_NAME, &my_uart3_fops);
-	if (major < 0)
-		return major;
+	chan = dma_request_chan(port->dev, "rx");
+	if (IS_ERR(chan)) {
+		ret = PTR_ERR(chan);
+		goto err;
+	}
+	dma->rx_chan = chan;
 
-	uart3_base = ioremap(UART3_BASE_PHYS, UART3_REG_SIZE);
-	if (!uart3_base) {
-		unregister_chrdev(major, DEVICE_NAME);
-		return -ENOMEM;
+	chan = dma_request_chan(port->dev, "tx");
+	if (IS_ERR(chan)) {
+		ret = PTR_ERR(chan);
+		goto err;
 	}
+	dma->tx_chan = chan;
 
-	ret = request_irq(irq, my_uart3_isr, IRQF_SHARED, DEVICE_NAME, &uart3_base);
-	if (ret) {
-		iounmap(uart3_base);
-		unregister_chrdev(major, DEVICE_NAME);
-		return ret;
+	ret = dmaengine_slave_config(dma->rx_chan, &rx_cfg);
+	if (!ret)
+		ret = dmaengine_slave_config(dma->tx_chan, &tx_cfg);
+	if (ret)
+		goto err;
+
+	dma->rx_buf = dma_alloc_coherent(uart_dma_dev(dma->rx_chan), DMA_RX_BUF_SZ,
+					 &dma->rx_addr, GFP_KERNEL);
+	if (!dma->rx_buf) {
+		ret = -ENOMEM;
+		goto err;
 	}
 
-	pr_info("my_uart3: loaded (major %d, irq %d, base 0x%lx)\n",
-		major, irq, (unsigned long)UART3_BASE_PHYS);
+	ret = uart_dma_rx_start(port);
+	if (ret)
+		goto err;
+
+	port->dma_active = true;
 	return 0;
+
+err:
+	uart_dma_release(port);
+	return ret;
 }
 
-static void __exit my_uart3_exit(void)
+/* ---- FIFO trigger levels ---- */
+static void my_uart_write_ifls(struct my_uart_port *port)
 {
-	if (uart3_base) {
-		/* Mask and clear all interrupts */
-		writel(0x0, uart3_base + UART_IMSC);
-		writel(0x7FF, uart3_base + UART_ICR);
-	}
+	writel(UART_IFLS_RX(port->rx_ifls) | UART_IFLS_TX(port->tx_ifls),
+	       port->base + UART_IFLS);
+}
+
+static int ifls_from_eighths(unsigned int eighths)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ifls_eighths); i++)
+		if (ifls_eighths[i] == eighths)
+			return i;
+	return -EINVAL;
+}
+
+static unsigned int irqs_per_kb(u64 irqs, u64 bytes)
+{
+	if (!bytes)
+		return 0;
+	return div64_u64(irqs * 1024, bytes);
+}
+
+/* ---- Line settings ---- */
+/* Start + data + parity + stop bits per character */
+static unsigned int my_uart_char_bits(const struct my_uart_line_cfg *cfg)
+{
+	return 1 + cfg->data_bits + (cfg->parity != MY_UART_PARITY_NONE) + cfg->stop_bits;
+}
+
+/*
+ * Divisor = UARTCLK / (16 * baud) as a 16.6 fixed point value:
+ * IBRD holds the integer part and FBRD the 1/64ths, rounded to nearest.
+ */
+static int my_uart_calc_divisor(unsigned long uartclk, u32 baud,
+				unsigned int *ibrd, unsigned int *fbrd)
+{
+	u64 div64;
+
+	if (!baud)
+		return -EINVAL;
+	div64 = div_u64((u64)uartclk * 4 + baud / 2, baud);
+	*ibrd = div64 >> 6;
+	*fbrd = div64 & 0x3f;
+	if (*ibrd == 0 || *ibrd > 0xffff)
+		return -EINVAL;
+	return 0;
+}
+
+static u32 my_uart_actual_baud(unsigned long uartclk, unsigned int ibrd, unsigned int fbrd)
+{
+	return div_u64((u64)uartclk * 4, ibrd * 64 + fbrd);
+}
+
+/* cfg_lock held: may RX run with this overflow policy and flow setting? */
+static bool my_uart_block_ok(struct my_uart_port *port, u8 overflow, u32 flow)
+{
+	return overflow != MY_UART_OVERFLOW_BLOCK || !port->dma_active ||
+	       flow == MY_UART_FLOW_RTSCTS;
+}
+
+static int my_uart_check_line(const struct my_uart_line_cfg *cfg)
+{
+	if (cfg->data_bits < 5 || cfg->data_bits > 8)
+		return -EINVAL;
+	if (cfg->parity > MY_UART_PARITY_EVEN)
+		return -EINVAL;
+	if (cfg->stop_bits != 1 && cfg->stop_bits != 2)
+		return -EINVAL;
+	if (cfg->flow > MY_UART_FLOW_RTSCTS)
+		return -EINVAL;
+	return 0;
+}
 
-	if (irq >= 0)
-		free_irq(irq, &uart3_base);
+static u32 my_uart_lcrh(const struct my_uart_line_cfg *cfg)
+{
+	u32 lcrh = UART_LCRH_FEN | UART_LCRH_WLEN(cfg->data_bits);
 
-	if (uart3_base)
-		iounmap(uart3_base);
+	if (cfg->parity != MY_UART_PARITY_NONE)
+		lcrh |= UART_LCRH_PEN;
+	if (cfg->parity == MY_UART_PARITY_EVEN)
+		lcrh |= UART_LCRH_EPS;
+	if (cfg->stop_bits == 2)
+		lcrh |= UART_LCRH_STP2;
+	return lcrh;
+}
 
-	if (major >= 0)
-		unregister_chrdev(major, DEVICE_NAME);
+/* IBRD/FBRD only latch on the following LCRH write, so keep this order */
+static void my_uart_write_line(struct my_uart_port *port)
+{
+	writel(port->ibrd, port->base + UART_IBRD);
+	writel(port->fbrd, port->base + UART_FBRD);
+	writel(my_uart_lcrh(&port->line_cfg), port->base + UART_LCRH);
+}
+
+static void my_uart_get_line(struct my_uart_port *port, struct my_uart_line_info *info)
+{
+	u32 actual = my_uart_actual_baud(port->uartclk, port->ibrd, port->fbrd);
+	u32 baud = port->line_cfg.baud;
+
+	memset(info, 0, sizeof(*info));
+	info->cfg = port->line_cfg;
+	info->actual_baud = actual;
+	info->error_ppm = div_s64(((s64)actual - baud) * 1000000, baud);
+	info->uartclk = port->uartclk;
+	info->ibrd = port->ibrd;
+	info->fbrd = port->fbrd;
+}
+
+/*
+ * Runtime line change: block writers, let txrb and the TX FIFO run dry, then
+ * reprogram with the UART disabled as the PL011 TRM requires. Bytes still in
+ * the RX FIFO at that point belong to the old settings anyway.
+ * The caller has the port open, so the UART is running here. line_cfg and
+ * the divisors are cached in the port, and my_uart_startup() re-applies them
+ * on the next first open after the last release.
+ */
+static int my_uart_set_line(struct my_uart_port *port, const struct my_uart_line_cfg *cfg)
+{
+	unsigned int ibrd, fbrd;
+	unsigned long flags;
+	u32 cr, fr;
+	long left;
+	int ret;
+
+	ret = my_uart_check_line(cfg);
+	if (ret)
+		return ret;
+	ret = my_uart_calc_divisor(port->uartclk, cfg->baud, &ibrd, &fbrd);
+	if (ret)
+		return ret;
+
+	if (mutex_lock_interruptible(&port->txrb.user))
+		return -ERESTARTSYS;
+	mutex_lock(&port->cfg_lock);
+	/* The ioctl entry check raced with my_uart_remove(); this one cannot */
+	if (port->dead) {
+		ret = -ENODEV;
+		goto out;
+	}
+	if (!my_uart_block_ok(port, port->rx_overflow, cfg->flow)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	left = wait_event_interruptible_timeout(port->tx_wq, rb_empty(&port->txrb),
+						msecs_to_jiffies(LINE_DRAIN_MS));
+	if (left <= 0) {
+		ret = left ? left : -ETIMEDOUT;
+		goto out;
+	}
+	ret = readl_poll_timeout(port->base + UART_FR, fr, !(fr & UART_FR_BUSY),
+				 10, LINE_DRAIN_MS * USEC_PER_MSEC);
+	if (ret)
+		goto out;
+
+	spin_lock_irqsave(&port->lock, flags);
+	port->line_cfg = *cfg;
+	port->ibrd = ibrd;
+	port->fbrd = fbrd;
+
+	/*
+	 * Re-enable with the new flow setting and RTS asserted; if rxrb is still
+	 * above the high-water mark the next RX drain throttles again.
+	 */
+	cr = readl(port->base + UART_CR);
+	writel(cr & ~UART_CR_UARTEN, port->base + UART_CR);
+	my_uart_write_line(port);
+	if (cr & UART_CR_UARTEN)
+		cr = my_uart_cr(port);
+	writel(cr, port->base + UART_CR);
+	port->rx_throttled = false;
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	dev_info(port->dev, "my_uart%u: line %u %u%c%u (actual %u)\n", port->line,
+		 cfg->baud, cfg->data_bits, "NOE"[cfg->parity], cfg->stop_bits,
+		 my_uart_actual_baud(port->uartclk, ibrd, fbrd));
+out:
+	mutex_unlock(&port->cfg_lock);
+	mutex_unlock(&port->txrb.user);
+	return ret;
+}
+
+/* ---- Idle-gap framing (MY_UART_FRAMING_IDLE) ---- */
+static u64 my_uart_idle_gap_ns(struct my_uart_port *port)
+{
+	const struct my_uart_line_cfg *cfg = &port->line_cfg;
+
+	if (port->idle_gap_us)
+		return (u64)port->idle_gap_us * NSEC_PER_USEC;
+	/* Modbus RTU t3.5: 3.5 character times, fixed at 1750 us above 19200 baud */
+	if (cfg->baud > 19200)
+		return 1750 * NSEC_PER_USEC;
+	return div_u64(7ULL * my_uart_char_bits(cfg) * NSEC_PER_SEC, 2 * cfg->baud);
+}
+
+/*
+ * Under rx_lock, after a drain that took bytes: (re)start the gap. The RX
+ * timeout interrupt fires 32 bit periods after the last byte, so that much
+ * of the gap has already passed; the hrtimer measures only the rest. After
+ * a FIFO-level drain the last byte has only just arrived.
+ */
+static void my_uart_idle_arm(struct my_uart_port *port, bool rtim)
+{
+	u64 gap = my_uart_idle_gap_ns(port);
+
+	if (rtim)
+		gap -= min_t(u64, gap, div_u64(32ULL * NSEC_PER_SEC, port->line_cfg.baud));
+	port->idle_deadline = ktime_add_ns(ktime_get(), gap);
+	hrtimer_start(&port->idle_timer, ns_to_ktime(gap), HRTIMER_MODE_REL);
+}
+
+/* Under rx_lock: hand the burst collected so far to read() */
+static bool my_uart_idle_end(struct my_uart_port *port)
+{
+	struct frame_rx *f = &port->frx;
+	bool queued = false;
+
+	if (f->bad)
+		port->stats.rx_bad_frames++;
+	else if (!f->len)
+		return false;
+	else if (!my_uart_rx_record(port, f->buf, f->len))
+		port->stats.rx_dropped_frames++;
+	else
+		queued = true;
+
+	if (queued)
+		port->stats.rx_frames++;
+	f->len = 0;
+	f->bad = false;
+	return queued;
+}
+
+static enum hrtimer_restart my_uart_idle_timer(struct hrtimer *t)
+{
+	struct my_uart_port *port = container_of(t, struct my_uart_port, idle_timer);
+	unsigned long flags;
+	bool queued = false;
+
+	spin_lock_irqsave(&port->rx_lock, flags);
+	if (port->frx.mode != MY_UART_FRAMING_IDLE)
+		goto out;
+	/* A drain on another CPU moved the deadline; its expiry decides */
+	if (ktime_before(ktime_get(), port->idle_deadline))
+		goto out;
+	/*
+	 * Bytes inside the gap continue the burst. With DMA take them now (that
+	 * re-arms the gap); in PIO the RX interrupt that follows re-arms it.
+	 */
+	if (port->dma_active ? __uart_dma_rx_drain(port) :
+	    !(readl(port->base + UART_FR) & UART_FR_RXFE))
+		goto out;
+	queued = my_uart_idle_end(port);
+out:
+	spin_unlock_irqrestore(&port->rx_lock, flags);
+
+	if (queued) {
+		trace_my_uart_rx_put(port->line, 0, rb_fill(&port->rxrb));
+		wake_up_interruptible(&port->rx_wq);
+	}
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Called from the ISR once per ADAPT_WINDOW_MS. If most RX interrupts were
+ * timeouts the traffic is short request/response bursts, so lower the
+ * trigger for latency; if the line ran above a quarter of its capacity with
+ * few timeouts it is bulk traffic, so raise it for fewer interrupts.
+ */
+static void my_uart_adapt_rx(struct my_uart_port *port)
+{
+	struct my_uart_stats *b = &port->adapt_base;
+	u64 rx_irqs, rt_irqs, bytes, line_bytes;
+	u8 lvl = port->rx_ifls;
+	unsigned long flags;
+
+	if (!time_after(jiffies, port->adapt_start + msecs_to_jiffies(ADAPT_WINDOW_MS)))
+		return;
+
+	rx_irqs = port->stats.rx_irqs - b->rx_irqs;
+	rt_irqs = port->stats.rt_irqs - b->rt_irqs;
+	bytes = port->stats.rx_bytes - b->rx_bytes;
+	/* div_u64(): a plain u64 '/' needs __aeabi_uldivmod on 32-bit ARM */
+	line_bytes = div_u64((u64)port->line_cfg.baud * ADAPT_WINDOW_MS,
+			     my_uart_char_bits(&port->line_cfg) * MSEC_PER_SEC);
+
+	if (rt_irqs > rx_irqs && lvl > 0)
+		lvl--;
+	else if (bytes * 4 >= line_bytes && rt_irqs * 4 < rx_irqs &&
+		 lvl < ARRAY_SIZE(ifls_eighths) - 1)
+		lvl++;
+
+	if (lvl != port->rx_ifls) {
+		spin_lock_irqsave(&port->lock, flags);
+		port->rx_ifls = lvl;
+		my_uart_write_ifls(port);
+		spin_unlock_irqrestore(&port->lock, flags);
+	}
+
+	port->adapt_start = jiffies;
+	*b = port->stats;
+}
+
+static void my_uart_count_dr_errors(struct my_uart_port *port, u32 dr)
+{
+	if (dr & UART_DR_OE)
+		port->stats.overrun_errs++;
+	if (dr & UART_DR_BE)
+		port->stats.break_errs++;
+	if (dr & UART_DR_PE)
+		port->stats.parity_errs++;
+	if (dr & UART_DR_FE)
+		port->stats.frame_errs++;
+	/* A framed byte with a line error spoils its frame */
+	if (my_uart_framed(port))
+		port->frx.bad = true;
+}
+
+/* DMA mode never sees DR error bits; fall back to the latched raw status */
+static void my_uart_count_ris_errors(struct my_uart_port *port)
+{
+	u32 ris = readl(port->base + UART_RIS);
+
+	if (ris & UART_ICR_OEIC)
+		port->stats.overrun_errs++;
+	if (ris & UART_ICR_BEIC)
+		port->stats.break_errs++;
+	if (ris & UART_ICR_PEIC)
+		port->stats.parity_errs++;
+	if (ris & UART_ICR_FEIC)
+		port->stats.frame_errs++;
+}
+
+/*
+ * PIO: move what the RX FIFO holds into rxrb. From the ISR, the IRQ thread
+ * or a busy-polling read(); irqsave as the last two can be interrupted by
+ * the ISR or the idle timer. rtim: the RX timeout fired, see idle_arm().
+ */
+static unsigned int my_uart_rx_drain_pio(struct my_uart_port *port, bool rtim, u64 ns)
+{
+	unsigned int head, moved = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->rx_lock, flags);
+	/* my_uart_remove() syncs with rx_lock after setting dead */
+	if (my_uart_dead(port)) {
+		spin_unlock_irqrestore(&port->rx_lock, flags);
+		return 0;
+	}
+	head = port->rxrb.ix->head;
+	while (!(readl(port->base + UART_FR) & UART_FR_RXFE)) {
+		u32 dr;
+
+		if (my_uart_rx_block(port) && !my_uart_rx_room(port)) {
+			my_uart_rx_stall(port);
+			break;
+		}
+		/* The error bits come with the data; no status read needed */
+		dr = readl(port->base + UART_DR);
+		if (unlikely(dr & (UART_DR_FE | UART_DR_PE | UART_DR_BE | UART_DR_OE)))
+			my_uart_count_dr_errors(port, dr);
+		my_uart_rx_char(port, dr & 0xFF, (dr >> DR_ERR_SHIFT) & 0xF);
+		moved++;
+	}
+	if (moved && port->frx.mode == MY_UART_FRAMING_IDLE)
+		my_uart_idle_arm(port, rtim);
+	my_uart_rx_ts_put(port, head, ns);
+	if (moved)
+		WRITE_ONCE(port->rx_last_ns, ns);
+	port->stats.rx_bytes += moved;
+	my_uart_rx_fill_sample(port);
+	spin_unlock_irqrestore(&port->rx_lock, flags);
+
+	my_uart_rx_throttle(port);
+	trace_my_uart_rx_put(port->line, moved, rb_fill(&port->rxrb));
+	wake_up_interruptible(&port->rx_wq);
+	return moved;
+}
+
+/*
+ * Service the sources in mis: from the hard handler, or from the IRQ
+ * thread with them still masked. Returns false if there was nothing to do.
+ */
+static bool my_uart_handle_irq(struct my_uart_port *port, u32 mis)
+{
+	u64 t0, dt, tx_before;
+	unsigned int moved = 0, tx_moved;
+	bool handled = false;
+
+	t0 = ktime_get_ns();
+	tx_before = port->stats.tx_bytes;
+	port->stats.isr_calls++;
+	trace_my_uart_isr_entry(port->line, mis);
+
+	/* RX or timeout */
+	if (mis & (UART_IMSC_RXIM | UART_IMSC_RTIM)) {
+		if (mis & UART_IMSC_RXIM)
+			port->stats.rx_irqs++;
+		if (mis & UART_IMSC_RTIM)
+			port->stats.rt_irqs++;
+
+		if (port->dma_active) {
+			/* Timeout with DMA running: flush what the engine already wrote */
+			my_uart_count_ris_errors(port);
+			moved = uart_dma_rx_drain(port);
+		} else {
+			moved = my_uart_rx_drain_pio(port, mis & UART_IMSC_RTIM, t0);
+		}
+
+		if (port->adaptive_rx)
+			my_uart_adapt_rx(port);
+
+		/* Clear RX-related sources and error latches */
+		writel(UART_ICR_RXIC | UART_ICR_RTIC |
+		       UART_ICR_FEIC | UART_ICR_PEIC | UART_ICR_BEIC | UART_ICR_OEIC,
+		       port->base + UART_ICR);
+		handled = true;
+	}
+
+	/* TX FIFO space available */
+	if (mis & UART_IMSC_TXIM) {
+		port->stats.tx_irqs++;
+		uart_tx_kick(port);
+		writel(UART_ICR_TXIC, port->base + UART_ICR);
+		handled = true;
+	}
+
+	tx_moved = port->stats.tx_bytes - tx_before;
+	dt = ktime_get_ns() - t0;
+	hist_add(port->hist.bytes_per_isr, moved + tx_moved);
+	hist_add(port->hist.isr_ns, dt);
+	if (dt > port->stats.isr_max_ns)
+		port->stats.isr_max_ns = dt;
+	trace_my_uart_isr_exit(port->line, mis, moved, tx_moved, rb_fill(&port->rxrb));
+
+	return handled;
+}
+
+static irqreturn_t my_uart3_isr(int irqno, void *dev_id)
+{
+	struct my_uart_port *port = dev_id;
+	u32 mis = readl(port->base + UART_MIS);
+
+	/* Shared line: not ours */
+	if (!mis)
+		return IRQ_NONE;
+
+	return my_uart_handle_irq(port, mis) ? IRQ_HANDLED : IRQ_NONE;
+}
+
+/*
+ * Threaded mode, hard IRQ context: mask what fired and wake the thread.
+ * The FIFO level sources cannot be cleared before the FIFO is drained,
+ * so masking them is what quiets the line.
+ */
+static irqreturn_t my_uart3_isr_hard(int irqno, void *dev_id)
+{
+	struct my_uart_port *port = dev_id;
+	u32 mis = readl(port->base + UART_MIS);
+
+	if (!mis)
+		return IRQ_NONE;
+
+	raw_spin_lock(&port->irq_lock);
+	port->irq_masked |= mis;
+	writel(port->imsc & ~port->irq_masked, port->base + UART_IMSC);
+	port->irq_hard_ns = ktime_get_ns();
+	raw_spin_unlock(&port->irq_lock);
+	return IRQ_WAKE_THREAD;
+}
+
+/* From the IRQ thread itself: there is no exported way to reach its task_struct */
+static void my_uart_irq_thread_setup(struct my_uart_port *port)
+{
+	/* sched_setscheduler_nocheck() is not exported to modules */
+	struct sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_FIFO,
+	};
+	const struct cpumask *cpus;
+	int ret;
+
+	if (!atomic_xchg(&port->thread_setup, 0))
+		return;
+
+	mutex_lock(&port->thread_lock);
+	attr.sched_priority = port->thread_prio ?: MAX_RT_PRIO / 2;
+	ret = sched_setattr_nocheck(current, &attr);
+	if (ret)
+		dev_warn(port->dev, "my_uart%u: IRQ thread priority %u: %d\n",
+			 port->line, attr.sched_priority, ret);
+	/* Cleared: back to the IRQ's own affinity, as request_irq() set it up */
+	cpus = cpumask_empty(&port->thread_cpus) ?
+	       irq_data_get_affinity_mask(irq_get_irq_data(port->irq)) : &port->thread_cpus;
+	ret = set_cpus_allowed_ptr(current, cpus);
+	if (ret)
+		dev_warn(port->dev, "my_uart%u: IRQ thread CPUs %*pbl: %d\n",
+			 port->line, cpumask_pr_args(cpus), ret);
+	mutex_unlock(&port->thread_lock);
+}
+
+static irqreturn_t my_uart3_irq_thread(int irqno, void *dev_id)
+{
+	struct my_uart_port *port = dev_id;
+	unsigned long flags;
+	u64 wake;
+	u32 mis;
+
+	my_uart_irq_thread_setup(port);
+
+	raw_spin_lock_irqsave(&port->irq_lock, flags);
+	mis = port->irq_masked;
+	wake = ktime_get_ns() - port->irq_hard_ns;
+	raw_spin_unlock_irqrestore(&port->irq_lock, flags);
+
+	/* Woken again while running: the previous pass already took it all */
+	if (!mis)
+		return IRQ_HANDLED;
+
+	hist_add(port->hist.irq_wake_ns, wake);
+	if (wake > port->stats.irq_wake_max_ns)
+		port->stats.irq_wake_max_ns = wake;
+
+	my_uart_handle_irq(port, mis);
+
+	/*
+	 * Level sources that are still pending fire again straight away, and
+	 * an RX timeout stays latched in RIS until it is cleared, so nothing
+	 * that arrived while masked is lost.
+	 */
+	raw_spin_lock_irqsave(&port->irq_lock, flags);
+	port->irq_masked = 0;
+	writel(port->imsc, port->base + UART_IMSC);
+	raw_spin_unlock_irqrestore(&port->irq_lock, flags);
+	return IRQ_HANDLED;
+}
+
+/* ---- Char device fops ---- */
+/* First open, under cfg_lock: bring the UART up from the quiesced state */
+static int my_uart_startup(struct my_uart_port *port)
+{
+	int ret;
+
+	ret = clk_prepare_enable(port->clk);
+	if (ret)
+		return ret;
+
+	/* Disable and clear */
+	writel(0x0,  port->base + UART_CR);
+	writel(0x7FF, port->base + UART_ICR);
+
+	/* Program baud and framing (last MY_UART_IOC_SET_LINE, or module defaults) */
+	my_uart_write_line(port);
+	my_uart_write_ifls(port);
+
+	if (port->dma_active) {
+		/* DMA drains the FIFO; keep RX timeout to flush partial periods */
+		writel(UART_DMACR_RXDMAE | UART_DMACR_TXDMAE, port->base + UART_DMACR);
+		my_uart_imsc(port, ~0U, UART_IMSC_RTIM);
+		mod_timer(&port->dma.rx_poll, jiffies + msecs_to_jiffies(DMA_RX_POLL_MS));
+	} else {
+		/* Enable RX + RX timeout interrupts now; TXIM is armed on demand */
+		writel(0x0, port->base + UART_DMACR);
+		my_uart_imsc(port, ~0U, UART_IMSC_RXIM | UART_IMSC_RTIM);
+	}
+
+	/* Enable with optional internal loopback and RTS/CTS */
+	port->rx_throttled = false;
+	port->rx_stalled = false;
+	writel(my_uart_cr(port), port->base + UART_CR);
+	/* TX left over from a shutdown that gave up on draining goes out now */
+	uart_tx_kick(port);
+
+	dev_info(port->dev, "my_uart%u: configured %u %u%c%u (%s)\n",
+		 port->line, port->line_cfg.baud, port->line_cfg.data_bits,
+		 "NOE"[port->line_cfg.parity], port->line_cfg.stop_bits,
+		 port->dma_active ? "dma" : "pio");
+	return 0;
+}
+
+/*
+ * Last release, under cfg_lock: let queued TX out, then mask everything,
+ * turn the UART off and gate its clock. RX bytes still in rxrb stay for
+ * the next open; anything the peer sends meanwhile is not received.
+ * From my_uart_remove() (dead) queued TX is dropped instead.
+ */
+static void my_uart_shutdown(struct my_uart_port *port)
+{
+	u32 fr;
+
+	if (!port->dead &&
+	    (!wait_event_timeout(port->tx_wq, rb_empty(&port->txrb),
+				 msecs_to_jiffies(LINE_DRAIN_MS)) ||
+	     readl_poll_timeout(port->base + UART_FR, fr, !(fr & UART_FR_BUSY),
+				10, LINE_DRAIN_MS * USEC_PER_MSEC)))
+		dev_warn(port->dev, "my_uart%u: TX not drained, %u bytes held until next open\n",
+			 port->line, rb_fill(&port->txrb));
+
+	my_uart_imsc(port, ~0U, 0);
+	writel(0x7FF, port->base + UART_ICR);
+	writel(0x0, port->base + UART_DMACR);
+	writel(0x0, port->base + UART_CR);
+	synchronize_irq(port->irq);
+	if (port->dma_active) {
+		timer_delete_sync(&port->dma.rx_poll);
+		/* What the engine wrote before RXDMAE went off */
+		uart_dma_rx_drain(port);
+	}
+	/* Last, as every RX drain above may re-arm it */
+	hrtimer_cancel(&port->idle_timer);
+	clk_disable_unprepare(port->clk);
+	dev_dbg(port->dev, "my_uart%u: shut down\n", port->line);
+}
+
+static int my_uart3_open(struct inode *inode, struct file *file)
+{
+	struct my_uart_port *port = container_of(inode->i_cdev, struct my_uart_port, cdev);
+	struct my_uart_file *f;
+	int ret = 0;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return -ENOMEM;
+	f->port = port;
+	f->eol = -1;
+	/* Fan-out readers start with what arrives from now on; a reset after the gen read resyncs */
+	f->rx_gen = READ_ONCE(port->rx_gen);
+	smp_rmb();
+	f->rx_pos = smp_load_acquire(&port->rxrb.ix->head);
+	file->private_data = f;
+	/* read_iter/write_iter honour IOCB_NOWAIT, so io_uring may try inline */
+	file->f_mode |= FMODE_NOWAIT;
+	trace_my_uart_open(port->line);
+
+	mutex_lock(&port->cfg_lock);
+	if (port->dead) {
+		ret = -ENODEV;
+		kfree(f);
+	} else if (!port->open_count++) {
+		ret = my_uart_startup(port);
+		if (ret) {
+			port->open_count--;
+			kfree(f);
+		}
+	}
+	mutex_unlock(&port->cfg_lock);
+	return ret;
+}
+
+/*
+ * O_NONBLOCK, or IOCB_NOWAIT from io_uring/RWF_NOWAIT: never sleep, not
+ * even on ring->user. io_uring then waits through ->poll() and retries.
+ */
+static bool my_uart_nowait(struct kiocb *iocb)
+{
+	return (iocb->ki_flags & IOCB_NOWAIT) || (iocb->ki_filp->f_flags & O_NONBLOCK);
+}
+
+static int my_uart_ring_lock(struct ring *r, bool nowait)
+{
+	if (nowait)
+		return mutex_trylock(&r->user) ? 0 : -EAGAIN;
+	return mutex_lock_interruptible(&r->user) ? -ERESTARTSYS : 0;
+}
+
+/* ---- SLIP framing: read()/write() side ---- */
+static bool my_uart_tx_room(struct my_uart_port *port)
+{
+	if (my_uart_framed(port))
+		return rb_space(&port->txrb) >= FRAME_ENC_MAX;
+	return !rb_full(&port->txrb);
+}
+
+/*
+ * One write() is one frame. In idle-gap mode the burst goes out verbatim
+ * and in one piece; spacing bursts apart is up to the caller. Called with
+ * txrb.user held.
+ */
+static ssize_t my_uart_write_frame(struct my_uart_port *port, struct iov_iter *from,
+				   bool nowait)
+{
+	struct ring *txrb = &port->txrb;
+	size_t count = iov_iter_count(from);
+	u8 *p = port->tx_frame;
+	unsigned int i, h, len = count;
+	u16 crc;
+	int ret;
+
+	if (count > MY_UART_FRAME_MAX)
+		return -EMSGSIZE;
+	if (!copy_from_iter_full(p, count, from))
+		return -EFAULT;
+	if (port->framing == MY_UART_FRAMING_SLIP) {
+		crc = my_uart_frame_crc(p, len);
+		p[len++] = crc & 0xFF;
+		p[len++] = crc >> 8;
+	}
+
+	/* Wait for worst-case room so the encoder never stops mid-frame */
+	while (rb_space(txrb) < FRAME_ENC_MAX) {
+		uart_tx_kick(port);
+		if (nowait)
+			return -EAGAIN;
+		ret = wait_event_interruptible(port->tx_wq, rb_space(txrb) >= FRAME_ENC_MAX ||
+					       my_uart_dead(port));
+		if (ret)
+			return ret;
+		if (my_uart_dead(port))
+			return -ENODEV;
+	}
+
+	h = txrb->ix->head;
+	if (port->framing == MY_UART_FRAMING_IDLE) {
+		for (i = 0; i < len; i++)
+			txrb->buf[rb_off(txrb, h++)] = p[i];
+		goto queued;
+	}
+
+	txrb->buf[rb_off(txrb, h++)] = SLIP_END;
+	for (i = 0; i < len; i++) {
+		if (p[i] == SLIP_END) {
+			txrb->buf[rb_off(txrb, h++)] = SLIP_ESC;
+			txrb->buf[rb_off(txrb, h++)] = SLIP_ESC_END;
+		} else if (p[i] == SLIP_ESC) {
+			txrb->buf[rb_off(txrb, h++)] = SLIP_ESC;
+			txrb->buf[rb_off(txrb, h++)] = SLIP_ESC_ESC;
+		} else {
+			txrb->buf[rb_off(txrb, h++)] = p[i];
+		}
+	}
+	txrb->buf[rb_off(txrb, h++)] = SLIP_END;
+queued:
+	trace_my_uart_tx_put(port->line, h - txrb->ix->head, rb_fill(txrb) + h - txrb->ix->head);
+	smp_store_release(&txrb->ix->head, h);
+	port->stats.tx_frames++;
+
+	uart_tx_kick(port);
+	return count;
+}
+
+/*
+ * One read() is one frame: datagram semantics, so whatever does not fit in
+ * the caller's buffer is discarded. Called with rxrb.user held and a record
+ * available. Returns the bytes copied, or -ESTALE if DROP_OLDEST took the
+ * frame away meanwhile.
+ */
+static ssize_t my_uart_read_frame(struct ring *rxrb, struct iov_iter *to)
+{
+	size_t count = iov_iter_count(to);
+	unsigned int t = READ_ONCE(rxrb->ix->tail);
+	unsigned int len, n;
+
+	len = (u8)rxrb->buf[rb_off(rxrb, t)] |
+	      (u8)rxrb->buf[rb_off(rxrb, t + 1)] << 8;
+	if (len + FRAME_HDR_LEN > rb_avail(rxrb)) {
+		/* tail left mid-record by an earlier mmap() user: resync */
+		if (!rb_commit(rxrb, t, smp_load_acquire(&rxrb->ix->head) - t))
+			return -ESTALE;	/* no, DROP_OLDEST moved it under us */
+		return -EIO;
+	}
+	n = min_t(size_t, len, count);
+
+	if (!rb_copy_to_iter(rxrb, t + FRAME_HDR_LEN, n, to))
+		return -EFAULT;
+
+	if (!rb_commit(rxrb, t, FRAME_HDR_LEN + len))
+		return -ESTALE;
+	return n;
+}
+
+/*
+ * Bulk paths: the caller holds ring->user, so it is the only one moving its
+ * own index. It snapshots the other index, copies straight between the
+ * iov_iter (user memory, or pipe pages for splice()/sendfile()) and at most
+ * two contiguous ring segments, then publishes the new index with a single
+ * release store.
+ */
+static ssize_t my_uart3_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct my_uart_file *f = iocb->ki_filp->private_data;
+	struct my_uart_port *port = f->port;
+	struct ring *txrb = &port->txrb;
+	size_t count = iov_iter_count(from);
+	bool nowait = my_uart_nowait(iocb);
+	unsigned int n, off, first, copied;
+	size_t done = 0;
+	int ret = 0;
+
+	if (my_uart_dead(port))
+		return -ENODEV;
+	if (atomic_read(&port->mmap_count))
+		return -EBUSY;
+	ret = my_uart_ring_lock(txrb, nowait);
+	if (ret)
+		return ret;
+
+	if (port->framing != MY_UART_FRAMING_NONE) {
+		ret = count ? my_uart_write_frame(port, from, nowait) : 0;
+		mutex_unlock(&txrb->user);
+		trace_my_uart_write(port->line, count, ret);
+		return ret;
+	}
+
+	while (done < count) {
+		n = min_t(size_t, rb_space(txrb), count - done);
+		if (!n) {
+			/* Make sure the ring is draining before we wait on it */
+			uart_tx_kick(port);
+			if (done)
+				break;
+			if (nowait) {
+				ret = -EAGAIN;
+				break;
+			}
+			ret = wait_event_interruptible(port->tx_wq, !rb_full(txrb) ||
+						       my_uart_dead(port));
+			if (ret)
+				break;
+			if (my_uart_dead(port)) {
+				ret = -ENODEV;
+				break;
+			}
+			continue;
+		}
+
+		off = rb_off(txrb, txrb->ix->head);
+		first = min(n, txrb->size - off);
+		copied = copy_from_iter(txrb->buf + off, first, from);
+		if (copied == first)
+			copied += copy_from_iter(txrb->buf, n - first, from);
+
+		/* A fault part way still sends what made it in */
+		if (copied) {
+			smp_store_release(&txrb->ix->head, txrb->ix->head + copied);
+			done += copied;
+			trace_my_uart_tx_put(port->line, copied, rb_fill(txrb));
+			uart_tx_kick(port);
+		}
+		if (copied < n) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	mutex_unlock(&txrb->user);
+	trace_my_uart_write(port->line, count, done ? done : ret);
+	return done ? done : ret;
+}
+
+/* Side data a read ioctl wants along with the bytes (MY_UART_IOC_READ_*) */
+struct my_uart_read_req {
+	struct my_uart_rx_ts __user *ts;
+	unsigned int ts_max;
+	unsigned int ts_filled;
+	u8 __user *err;
+	unsigned int err_bytes;
+};
+
+/*
+ * Consumer side, under rxrb.user: read() is taking n bytes starting at
+ * rxrb index from. Report the batches they came in.
+ */
+static int my_uart_rx_ts_take(struct my_uart_port *port, unsigned int from,
+			      unsigned int n, struct my_uart_read_req *req)
+{
+	struct ts_ring *tr = &port->rx_ts;
+	unsigned int head = smp_load_acquire(&tr->head);
+	unsigned int t = tr->tail;
+	struct my_uart_rx_ts ts = { };
+	int off;
+
+	while (head - t >= 2 && (int)(tr->ent[(t + 1) & (TS_RING_SZ - 1)].pos - from) <= 0)
+		t++;
+
+	for (; t != head && req->ts_filled < req->ts_max; t++) {
+		off = tr->ent[t & (TS_RING_SZ - 1)].pos - from;
+		if (off >= (int)n)
+			break;
+		ts.offset = max(off, 0);
+		ts.ns = tr->ent[t & (TS_RING_SZ - 1)].ns;
+		if (copy_to_user(&req->ts[req->ts_filled++], &ts, sizeof(ts)))
+			return -EFAULT;
+	}
+	return 0;
+}
+
+/*
+ * Consumer side, under rxrb.user: everything before rxrb index upto has
+ * been consumed. Drop the entries nothing unread refers to any more; the
+ * last one stays, as the bytes after it may still be unread.
+ */
+static void my_uart_rx_ts_prune(struct my_uart_port *port, unsigned int upto)
+{
+	struct ts_ring *tr = &port->rx_ts;
+	unsigned int head = smp_load_acquire(&tr->head);
+	unsigned int t = tr->tail;
+
+	while (head - t >= 2 && (int)(tr->ent[(t + 1) & (TS_RING_SZ - 1)].pos - upto) <= 0)
+		t++;
+	smp_store_release(&tr->tail, t);
+}
+
+/* Report the flagged slots in [start, end); slot base holds data byte 0 */
+static int my_uart_rx_err_scan(struct my_uart_port *port, unsigned int start,
+			       unsigned int end, unsigned int base,
+			       struct my_uart_read_req *req)
+{
+	unsigned long slot = start;
+	u8 f;
+	int i;
+
+	for_each_set_bit_from(slot, port->rx_err[RX_ERR_ANY], end) {
+		f = 0;
+		for (i = 0; i < RX_ERR_PLANES; i++)
+			if (test_bit(slot, port->rx_err[i]))
+				f |= BIT(i);
+		if (put_user(f, &req->err[rb_off(&port->rxrb, slot - base)]))
+			return -EFAULT;
+		req->err_bytes++;
+	}
+	return 0;
+}
+
+/*
+ * Consumer side, under rxrb.user: flags for the n bytes read from rxrb
+ * index from. The user buffer is zeroed and only flagged bytes are written,
+ * found through the summary plane.
+ */
+static int my_uart_rx_err_take(struct my_uart_port *port, unsigned int from,
+			       unsigned int n, struct my_uart_read_req *req)
+{
+	unsigned int off = rb_off(&port->rxrb, from);
+	unsigned int first = min(n, port->rxrb.size - off);
+	int ret;
+
+	if (clear_user(req->err, n))
+		return -EFAULT;
+	ret = my_uart_rx_err_scan(port, off, off + first, off, req);
+	if (!ret && n > first)
+		ret = my_uart_rx_err_scan(port, 0, n - first, off, req);
+	return ret;
+}
+
+/* Consumer side: forget every stamp, e.g. when rxrb changes meaning */
+static void my_uart_rx_ts_flush(struct my_uart_port *port)
+{
+	smp_store_release(&port->rx_ts.tail, smp_load_acquire(&port->rx_ts.head));
+}
+
+/* Anything for this file to read? Fan-out: past its own cursor */
+static bool my_uart_rx_ready(struct my_uart_file *f)
+{
+	struct my_uart_port *port = f->port;
+
+	if (READ_ONCE(port->fanout))
+		return smp_load_acquire(&port->rxrb.ix->head) != READ_ONCE(f->rx_pos) ||
+		       READ_ONCE(port->rx_gen) != READ_ONCE(f->rx_gen);
+	return !rb_empty(&port->rxrb);
+}
+
+/* ---- Read wakeups (MY_UART_IOC_SET_WAKE) ---- */
+/* Where this file reads from: its own cursor under fan-out, else the ring's tail */
+static inline unsigned int my_uart_rx_pos(struct my_uart_file *f)
+{
+	if (READ_ONCE(f->port->fanout))
+		return READ_ONCE(f->rx_pos);
+	return READ_ONCE(f->port->rxrb.ix->tail);
+}
+
+/* Would anything but "some data" satisfy read()? */
+static inline bool my_uart_rx_wake_set(struct my_uart_file *f)
+{
+	return f->port->framing == MY_UART_FRAMING_NONE &&
+	       (READ_ONCE(f->vmin) > 1 || READ_ONCE(f->vtime_us) || READ_ONCE(f->eol) >= 0);
+}
+
+struct my_uart_rx_waiter {
+	struct wait_queue_entry wq;
+	struct my_uart_file *f;
+	unsigned int min;	/* bytes that satisfy the read */
+	int eol;		/* -1: none */
+	unsigned int scan;	/* EOL searched up to this index */
+	unsigned int gen;	/* port->rx_gen at the start */
+	bool first;		/* VTIME not running yet: the first byte starts it */
+};
+
+static void my_uart_rx_waiter_init(struct my_uart_rx_waiter *w, struct my_uart_file *f,
+				   size_t count)
+{
+	struct my_uart_port *port = f->port;
+
+	w->f = f;
+	w->min = 1;
+	w->eol = -1;
+	if (port->framing == MY_UART_FRAMING_NONE) {
+		unsigned int max = port->rxrb.size;
+
+		/* RTS/CTS stops the peer at the high-water mark (not under fan-out) */
+		if (my_uart_flow(port) && !READ_ONCE(port->fanout))
+			max = RX_HIGH_WATER(max);
+		w->min = clamp_t(size_t, READ_ONCE(f->vmin), 1, min_t(size_t, count, max));
+		w->eol = READ_ONCE(f->eol);
+	}
+	w->gen = READ_ONCE(port->rx_gen);
+	w->scan = my_uart_rx_pos(f);
+	w->first = false;
+}
+
+/*
+ * Enough queued for w's read? Under rx_wq.lock, which is what keeps the
+ * producer-side calls (through my_uart_rx_wake) and read()'s own apart.
+ */
+static bool my_uart_rx_wake_ok(struct my_uart_rx_waiter *w)
+{
+	struct my_uart_port *port = w->f->port;
+	struct ring *rxrb = &port->rxrb;
+	unsigned int head = smp_load_acquire(&rxrb->ix->head);
+	unsigned int pos = my_uart_rx_pos(w->f);
+
+	/* Emptied, reset or switched to/from fan-out, or unbound: let read() look again */
+	if (READ_ONCE(port->rx_gen) != w->gen || my_uart_dead(port))
+		return true;
+	if (head - pos >= w->min)
+		return true;
+	if (w->eol < 0 || head == pos)
+		return false;
+
+	/* Only the bytes since the last look; stays on the delimiter once found */
+	if ((int)(w->scan - pos) < 0)
+		w->scan = pos;
+	for (; w->scan != head; w->scan++)
+		if ((u8)rxrb->buf[rb_off(rxrb, w->scan)] == w->eol)
+			return true;
+	return false;
+}
+
+/*
+ * Not enough for the read yet, but the first byte: an untimed sleep has to
+ * become a VTIME one. Wakes my_uart_rx_wait() without ending it.
+ */
+static bool my_uart_rx_first(struct my_uart_rx_waiter *w)
+{
+	return READ_ONCE(w->first) &&
+	       smp_load_acquire(&w->f->port->rxrb.ix->head) != my_uart_rx_pos(w->f);
+}
+
+/* rx_wq callback: runs in the producer's context, so most drains wake nobody */
+static int my_uart_rx_wake(struct wait_queue_entry *wq, unsigned int mode, int sync, void *key)
+{
+	struct my_uart_rx_waiter *w = container_of(wq, struct my_uart_rx_waiter, wq);
+
+	if (!my_uart_rx_wake_ok(w) && !my_uart_rx_first(w))
+		return 0;
+	return default_wake_function(wq, mode, sync, key);
+}
+
+static bool my_uart_rx_check(struct my_uart_rx_waiter *w)
+{
+	wait_queue_head_t *wqh = &w->f->port->rx_wq;
+	bool ok;
+
+	spin_lock_irq(&wqh->lock);
+	ok = my_uart_rx_wake_ok(w);
+	spin_unlock_irq(&wqh->lock);
+	return ok;
+}
+
+/*
+ * Sleep until f's wake condition holds for a read of count bytes, or its
+ * VTIME runs out: 0, 1 on timeout, or -ERESTARTSYS. VTIME counts from the
+ * last byte once one is queued (never before that unless VMIN is 0), and
+ * never from before this call.
+ */
+static int my_uart_rx_wait(struct my_uart_file *f, size_t count)
+{
+	struct my_uart_port *port = f->port;
+	struct my_uart_rx_waiter w;
+	u64 start = ktime_get_ns(), time_ns = 0, deadline;
+	ktime_t kt;
+	int ret = 0;
+
+	my_uart_rx_waiter_init(&w, f, count);
+	if (port->framing == MY_UART_FRAMING_NONE)
+		time_ns = (u64)READ_ONCE(f->vtime_us) * NSEC_PER_USEC;
+	init_waitqueue_func_entry(&w.wq, my_uart_rx_wake);
+	w.wq.private = current;
+
+	add_wait_queue(&port->rx_wq, &w.wq);
+	for (;;) {
+		bool queued;
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		/* Set before the check: a byte after it finds it under rx_wq.lock */
+		WRITE_ONCE(w.first, time_ns != 0);
+		if (my_uart_rx_check(&w))
+			break;
+		if (signal_pending(current)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+
+		queued = smp_load_acquire(&port->rxrb.ix->head) != my_uart_rx_pos(f);
+		if (!time_ns || (!queued && READ_ONCE(f->vmin))) {
+			schedule();
+			continue;
+		}
+		/* The clock runs; more bytes only move the deadline, no need to wake */
+		WRITE_ONCE(w.first, false);
+		deadline = (queued ? max(start, READ_ONCE(port->rx_last_ns)) : start) + time_ns;
+		if (ktime_get_ns() >= deadline) {
+			ret = 1;
+			break;
+		}
+		kt = ns_to_ktime(deadline);
+		schedule_hrtimeout(&kt, HRTIMER_MODE_ABS);
+	}
+	__set_current_state(TASK_RUNNING);
+	remove_wait_queue(&port->rx_wq, &w.wq);
+	return ret;
+}
+
+/* Byte stream with an EOL: n bytes from from, cut after the first delimiter */
+static unsigned int my_uart_rx_eol_trim(struct my_uart_file *f, unsigned int from,
+					unsigned int n)
+{
+	struct ring *rxrb = &f->port->rxrb;
+	int eol = READ_ONCE(f->eol);
+	unsigned int i;
+
+	if (eol < 0)
+		return n;
+	for (i = 0; i < n; i++)
+		if ((u8)rxrb->buf[rb_off(rxrb, from + i)] == eol)
+			return i + 1;
+	return n;
+}
+
+/*
+ * Spin for up to f->busy_poll_us waiting for rxrb to fill. Rather than wait
+ * for the trigger level or the RX timeout (32 bit times) to raise the IRQ,
+ * pull the FIFO (or the DMA buffer) directly; the ISR may still get there
+ * first, rx_lock sorts that out.
+ */
+static bool my_uart_busy_poll(struct my_uart_file *f)
+{
+	struct my_uart_port *port = f->port;
+	u64 end = local_clock() + (u64)READ_ONCE(f->busy_poll_us) * NSEC_PER_USEC;
+	bool drained = false;
+
+	f->busy_polls++;
+	atomic64_inc(&port->stats.busy_polls);
+	do {
+		/* Both check dead under rx_lock before touching the hardware */
+		if (port->dma_active)
+			drained |= uart_dma_rx_drain(port) != 0;
+		else
+			drained |= my_uart_rx_drain_pio(port, false, ktime_get_ns()) != 0;
+
+		/* Framed: a frame only shows up once its last byte is in */
+		if (my_uart_rx_ready(f)) {
+			f->busy_poll_hits++;
+			atomic64_inc(&port->stats.busy_poll_hits);
+			if (drained)
+				f->busy_poll_drained++;
+			return true;
+		}
+		cpu_relax();
+	} while (!need_resched() && !signal_pending(current) && local_clock() < end);
+
+	return false;
+}
+
+/*
+ * Fan-out: read from this file's own cursor. rxrb.tail belongs to the
+ * producer, which moves it to recycle space and may overwrite what is being
+ * copied, so check afterwards that it has not passed the cursor, seqlock
+ * style. rxrb.user only covers the copy: a reader waiting for data does
+ * not hold up the others. -ESTALE: fan-out was switched off meanwhile.
+ */
+static ssize_t my_uart_read_fanout(struct my_uart_file *f, struct iov_iter *to,
+				   struct my_uart_read_req *req, bool nowait)
+{
+	struct my_uart_port *port = f->port;
+	struct ring *rxrb = &port->rxrb;
+	size_t count = iov_iter_count(to);
+	struct iov_iter_state state;
+	unsigned int pos, head, tail, n, used;
+	bool polled = false, ok;
+	int waited = -1;
+	int ret;
+
+	iov_iter_save_state(to, &state);
+	for (;;) {
+		ret = my_uart_ring_lock(rxrb, nowait);
+		if (ret)
+			return ret;
+		if (!port->fanout) {
+			mutex_unlock(&rxrb->user);
+			return -ESTALE;
+		}
+		if (f->rx_gen != port->rx_gen) {
+			/* rxrb was emptied or reset under us: start over at its head */
+			f->rx_gen = port->rx_gen;
+			f->rx_pos = rxrb->ix->head;
+		}
+		head = smp_load_acquire(&rxrb->ix->head);
+		if (head != f->rx_pos && (nowait || waited >= 0 || !my_uart_rx_wake_set(f)))
+			break;
+		mutex_unlock(&rxrb->user);
+
+		if (nowait)
+			return -EAGAIN;
+		if (waited > 0)
+			return 0;	/* VTIME ran out with nothing queued */
+		if (head == f->rx_pos && !polled && READ_ONCE(f->busy_poll_us)) {
+			polled = true;
+			if (my_uart_busy_poll(f))
+				continue;
+		}
+		waited = my_uart_rx_wait(f, count);
+		if (waited < 0)
+			return waited;
+		if (my_uart_dead(port))
+			return -ENODEV;
+	}
+
+	/* tail after head: head - pos stays within the ring unless we were overtaken */
+	pos = f->rx_pos;
+	tail = smp_load_acquire(&rxrb->ix->tail);
+	if ((int)(tail - pos) > 0)
+		goto overrun;
+
+	if (port->framing != MY_UART_FRAMING_NONE) {
+		used = (u8)rxrb->buf[rb_off(rxrb, pos)] |
+		       (u8)rxrb->buf[rb_off(rxrb, pos + 1)] << 8;
+		used += FRAME_HDR_LEN;
+		n = min_t(size_t, used - FRAME_HDR_LEN, count);
+		ok = used <= head - pos &&
+		     rb_copy_to_iter(rxrb, pos + FRAME_HDR_LEN, n, to);
+	} else {
+		n = used = my_uart_rx_eol_trim(f, pos, min_t(size_t, head - pos, count));
+		ok = rb_copy_to_iter(rxrb, pos, n, to) &&
+		     !(req && req->err && my_uart_rx_err_take(port, pos, n, req));
+	}
+
+	/* Our loads of the data before the producer's tail move that precedes reuse */
+	smp_rmb();
+	tail = READ_ONCE(rxrb->ix->tail);
+	if ((int)(tail - pos) > 0)
+		goto overrun;
+	if (!ok) {
+		/* A record length past head is not a record: skip what is there */
+		if (used > head - pos)
+			f->rx_pos = head;
+		ret = used > head - pos ? -EIO : -EFAULT;
+		goto out;
+	}
+
+	f->rx_pos = pos + used;
+	trace_my_uart_rx_get(port->line, n, head - f->rx_pos);
+	ret = n;
+	goto out;
+
+overrun:
+	/* Report it once, then carry on with the oldest data still queued */
+	iov_iter_restore(to, &state);
+	if (req)
+		req->err_bytes = 0;
+	f->rx_overruns++;
+	f->rx_lost += tail - pos;
+	f->rx_pos = tail;
+	ret = -EPIPE;
+out:
+	mutex_unlock(&rxrb->user);
+	trace_my_uart_read(port->line, count, ret);
+	return ret;
+}
+
+static ssize_t my_uart_read(struct my_uart_file *f, struct iov_iter *to,
+			    struct my_uart_read_req *req, bool nowait)
+{
+	struct my_uart_port *port = f->port;
+	struct ring *rxrb = &port->rxrb;
+	size_t count = iov_iter_count(to);
+	struct iov_iter_state state;
+	unsigned int n, from, gen;
+	bool polled = false;
+	int waited = -1;
+	int ret;
+
+	if (my_uart_dead(port))
+		return -ENODEV;
+	if (count == 0)
+		return 0;
+	if (atomic_read(&port->mmap_count))
+		return -EBUSY;
+
+retry:
+	ret = my_uart_ring_lock(rxrb, nowait);
+	if (ret)
+		return ret;
+	/* MY_UART_IOC_SET_FANOUT flips the mode with rxrb.user held */
+	if (port->fanout) {
+		mutex_unlock(&rxrb->user);
+		ret = my_uart_read_fanout(f, to, req, nowait);
+		if (ret == -ESTALE)
+			goto retry;
+		return ret;
+	}
+
+	iov_iter_save_state(to, &state);
+again:
+	for (;;) {
+		n = min_t(size_t, rb_avail(rxrb), count);
+		/* Once woken, whatever is there goes: the condition held or VTIME ran out */
+		if (n && (nowait || waited >= 0 || !my_uart_rx_wake_set(f)))
+			break;
+
+		if (nowait) {
+			ret = -EAGAIN;
+			goto out;
+		}
+		if (waited > 0) {
+			ret = 0;	/* VTIME ran out with nothing queued */
+			goto out;
+		}
+		/* Once per read(): after a miss, sleeping is the cheaper way to wait */
+		if (!n && !polled && READ_ONCE(f->busy_poll_us)) {
+			polled = true;
+			if (my_uart_busy_poll(f))
+				continue;
+		}
+		/*
+		 * Sleep without rxrb.user, as the fan-out path does: SET_FRAMING,
+		 * SET_RING, SET_RX_TS and SET_FANOUT take it and must not wait
+		 * for traffic. Whatever they changed meanwhile is re-checked below.
+		 */
+		gen = port->rx_gen;
+		mutex_unlock(&rxrb->user);
+		waited = my_uart_rx_wait(f, count);
+		if (waited < 0 || my_uart_dead(port)) {
+			ret = waited < 0 ? waited : -ENODEV;
+			goto out_unlocked;
+		}
+		ret = my_uart_ring_lock(rxrb, false);
+		if (ret)
+			goto out_unlocked;
+		if (atomic_read(&port->mmap_count)) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (port->fanout) {
+			mutex_unlock(&rxrb->user);
+			goto retry;
+		}
+		/* Emptied or reset meanwhile: what woke us is gone, wait afresh */
+		if (port->rx_gen != gen)
+			waited = -1;
+	}
+
+	if (port->framing != MY_UART_FRAMING_NONE) {
+		ret = my_uart_read_frame(rxrb, to);
+		if (ret == -ESTALE) {
+			iov_iter_restore(to, &state);
+			goto again;
+		}
+		if (ret < 0)
+			goto out;
+		n = ret;
+	} else {
+		/*
+		 * n above came from an older (head, tail): a DROP_OLDEST
+		 * rb_drop() since then would push from + n past head. Size the
+		 * copy from this tail and a head loaded after it; a drop after
+		 * this point fails rb_commit() below instead.
+		 */
+		from = READ_ONCE(rxrb->ix->tail);
+		n = min(n, min(smp_load_acquire(&rxrb->ix->head) - from, rxrb->size));
+		if (!n)
+			goto again;
+		n = my_uart_rx_eol_trim(f, from, n);
+		if (!rb_copy_to_iter(rxrb, from, n, to)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		/* Side data first: on a fault nothing has been consumed */
+		if (req && req->err && my_uart_rx_err_take(port, from, n, req)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		if (req && my_uart_rx_ts_take(port, from, n, req)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		if (!rb_commit(rxrb, from, n)) {
+			/* DROP_OLDEST recycled what we copied: start over */
+			iov_iter_restore(to, &state);
+			if (req) {
+				req->ts_filled = 0;
+				req->err_bytes = 0;
+			}
+			goto again;
+		}
+		my_uart_rx_ts_prune(port, from + n);
+	}
+
+	trace_my_uart_rx_get(port->line, n, rb_fill(rxrb));
+	my_uart_rx_unthrottle(port);
+	ret = n;
+out:
+	mutex_unlock(&rxrb->user);
+out_unlocked:
+	trace_my_uart_read(port->line, count, ret);
+	return ret;
+}
+
+static ssize_t my_uart3_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	return my_uart_read(iocb->ki_filp->private_data, to, NULL, my_uart_nowait(iocb));
+}
+
+static __poll_t my_uart3_poll(struct file *file, poll_table *wait)
+{
+	struct my_uart_file *f = file->private_data;
+	struct my_uart_port *port = f->port;
+	__poll_t mask = 0;
+
+	poll_wait(file, &port->rx_wq, wait);
+	poll_wait(file, &port->tx_wq, wait);
+
+	if (my_uart_dead(port))
+		return EPOLLERR | EPOLLHUP;
+	if (atomic_read(&port->mmap_count)) {
+		/* Doorbell for a mapped ring: send what was queued, take RX off hold */
+		if (!rb_empty(&port->txrb))
+			uart_tx_kick(port);
+		my_uart_rx_unthrottle(port);
+	}
+
+	/* As n_tty: VMIN and EOL hold readiness back, unless VTIME would end the read anyway */
+	if (my_uart_rx_ready(f)) {
+		struct my_uart_rx_waiter w;
+
+		my_uart_rx_waiter_init(&w, f, SIZE_MAX);
+		if (!my_uart_rx_wake_set(f) || READ_ONCE(f->vtime_us) || my_uart_rx_check(&w))
+			mask |= EPOLLIN | EPOLLRDNORM;
+	}
+	if (my_uart_tx_room(port))
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	return mask;
+}
+
+/* ---- Coalescing controls (ioctl + sysfs) ---- */
+static void my_uart_get_coalesce(struct my_uart_port *port, struct my_uart_coalesce *c)
+{
+	memset(c, 0, sizeof(*c));
+	c->rx_trigger = ifls_eighths[port->rx_ifls];
+	c->tx_trigger = ifls_eighths[port->tx_ifls];
+	c->adaptive_rx = port->adaptive_rx;
+}
+
+static int my_uart_set_coalesce(struct my_uart_port *port, const struct my_uart_coalesce *c)
+{
+	int rx = ifls_from_eighths(c->rx_trigger);
+	int tx = ifls_from_eighths(c->tx_trigger);
+	unsigned long flags;
+
+	if (rx < 0 || tx < 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&port->lock, flags);
+	/* my_uart_remove() syncs with port->lock after setting dead */
+	if (my_uart_dead(port)) {
+		spin_unlock_irqrestore(&port->lock, flags);
+		return -ENODEV;
+	}
+	port->rx_ifls = rx;
+	port->tx_ifls = tx;
+	port->adaptive_rx = !!c->adaptive_rx;
+	port->adapt_start = jiffies;
+	port->adapt_base = port->stats;
+	my_uart_write_ifls(port);
+	spin_unlock_irqrestore(&port->lock, flags);
+	return 0;
+}
+
+static void my_uart_get_irq_stats(struct my_uart_port *port, struct my_uart_irq_stats *st)
+{
+	struct my_uart_stats s = port->stats;
+
+	memset(st, 0, sizeof(*st));
+	st->rx_irqs = s.rx_irqs;
+	st->rt_irqs = s.rt_irqs;
+	st->tx_irqs = s.tx_irqs;
+	st->rx_bytes = s.rx_bytes;
+	st->tx_bytes = s.tx_bytes;
+	st->rx_irqs_per_kb = irqs_per_kb(s.rx_irqs + s.rt_irqs, s.rx_bytes);
+	st->tx_irqs_per_kb = irqs_per_kb(s.tx_irqs, s.tx_bytes);
+}
+
+/* ---- Framing controls ---- */
+/* Wait until no RX producer can still be running in the old framing mode */
+static void my_uart_rx_sync(struct my_uart_port *port)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->rx_lock, flags);
+	spin_unlock_irqrestore(&port->rx_lock, flags);
+	hrtimer_cancel(&port->idle_timer);
+}
+
+static int my_uart_set_framing(struct my_uart_port *port, u32 mode)
+{
+	if (mode > MY_UART_FRAMING_IDLE)
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&port->rxrb.user))
+		return -ERESTARTSYS;
+	mutex_lock(&port->txrb.user);
+
+	if (mode != port->framing) {
+		WRITE_ONCE(port->framing, mode);
+		my_uart_rx_sync(port);
+		/* rxrb holds the old format; drop it (TX bytes already queued still go out) */
+		smp_store_release(&port->rxrb.ix->tail, smp_load_acquire(&port->rxrb.ix->head));
+		WRITE_ONCE(port->rx_gen, port->rx_gen + 1);
+		my_uart_rx_ts_flush(port);
+		my_uart_rx_unthrottle(port);
+	}
+
+	mutex_unlock(&port->txrb.user);
+	mutex_unlock(&port->rxrb.user);
+	return 0;
+}
+
+/* ---- Ring sizes and RX overflow policy ---- */
+static bool my_uart_ring_size_ok(unsigned int size)
+{
+	return is_power_of_2(size) && size >= MY_UART_RING_MIN && size <= MY_UART_RING_MAX;
+}
+
+/* RX_ERR_PLANES + 1 bitmaps of size bits, freed through the first one */
+static unsigned long *my_uart_rx_err_alloc(unsigned int size)
+{
+	return vzalloc(array3_size(RX_ERR_PLANES + 1, BITS_TO_LONGS(size), sizeof(long)));
+}
+
+static void my_uart_rx_err_set(struct my_uart_port *port, unsigned long *bits)
+{
+	unsigned int i;
+
+	for (i = 0; i <= RX_ERR_PLANES; i++)
+		port->rx_err[i] = bits + i * BITS_TO_LONGS(port->rxrb.size);
+}
+
+/* Ring offsets in the mmap() layout follow the sizes; cfg_lock held */
+static void my_uart_mmap_layout(struct my_uart_port *port)
+{
+	port->ctrl->rx.offset = PAGE_SIZE;
+	port->ctrl->tx.offset = PAGE_SIZE + rb_map_len(&port->rxrb);
+}
+
+/* cfg_lock held, like the layout */
+static unsigned long my_uart_mmap_len(struct my_uart_port *port)
+{
+	return PAGE_SIZE + rb_map_len(&port->rxrb) + rb_map_len(&port->txrb);
+}
+
+static void my_uart_get_ring(struct my_uart_port *port, struct my_uart_ring_cfg *rc)
+{
+	memset(rc, 0, sizeof(*rc));
+	rc->rx_size = port->rxrb.size;
+	rc->tx_size = port->txrb.size;
+	rc->rx_overflow = READ_ONCE(port->rx_overflow);
+}
+
+/*
+ * A new RX size drops whatever is queued; a new TX size first waits for
+ * txrb to drain. A policy-only change leaves both rings alone.
+ */
+static int my_uart_set_ring(struct my_uart_port *port, const struct my_uart_ring_cfg *rc)
+{
+	struct ring *rxrb = &port->rxrb, *txrb = &port->txrb;
+	bool rx_resize = rc->rx_size != rxrb->size;
+	bool tx_resize = rc->tx_size != txrb->size;
+	unsigned long *rx_err = NULL;
+	char *rxbuf = NULL, *txbuf = NULL;
+	unsigned long flags;
+	long left;
+	int ret = 0;
+
+	if (!my_uart_ring_size_ok(rc->rx_size) || !my_uart_ring_size_ok(rc->tx_size) ||
+	    rc->rx_overflow > MY_UART_OVERFLOW_BLOCK)
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&rxrb->user))
+		return -ERESTARTSYS;
+	mutex_lock(&txrb->user);
+
+	/*
+	 * txrb.user keeps writers out, so this only has to outwait the hardware;
+	 * bounded like SET_LINE's drain, as a stalled peer (CTS) never lets go
+	 */
+	if (tx_resize) {
+		left = wait_event_interruptible_timeout(port->tx_wq, !rb_avail(txrb),
+							msecs_to_jiffies(LINE_DRAIN_MS));
+		if (left <= 0) {
+			ret = left ? left : -ETIMEDOUT;
+			goto out_user;
+		}
+	}
+
+	mutex_lock(&port->cfg_lock);
+	if ((rx_resize || tx_resize) && atomic_read(&port->mmap_count)) {
+		ret = -EBUSY;
+		goto out;
+	}
+	if (!my_uart_block_ok(port, rc->rx_overflow, port->line_cfg.flow)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (rx_resize) {
+		rxbuf = vmalloc_user(rc->rx_size);
+		rx_err = my_uart_rx_err_alloc(rc->rx_size);
+	}
+	if (tx_resize)
+		txbuf = vmalloc_user(rc->tx_size);
+	if ((rx_resize && (!rxbuf || !rx_err)) || (tx_resize && !txbuf)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (rx_resize) {
+		spin_lock_irqsave(&port->rx_lock, flags);
+		swap(rxrb->buf, rxbuf);
+		rxrb->size = rc->rx_size;
+		rxrb->ix->size = rc->rx_size;
+		rxrb->ix->head = 0;
+		rxrb->ix->tail = 0;
+		WRITE_ONCE(port->rx_gen, port->rx_gen + 1);
+		rx_err = xchg(&port->rx_err[0], rx_err);
+		my_uart_rx_err_set(port, port->rx_err[0]);
+		my_uart_rx_ts_flush(port);
+		spin_unlock_irqrestore(&port->rx_lock, flags);
+		my_uart_rx_unthrottle(port);
+	}
+	if (tx_resize) {
+		spin_lock_irqsave(&port->tx_lock, flags);
+		swap(txrb->buf, txbuf);
+		txrb->size = rc->tx_size;
+		txrb->ix->size = rc->tx_size;
+		txrb->ix->head = 0;
+		txrb->ix->tail = 0;
+		spin_unlock_irqrestore(&port->tx_lock, flags);
+	}
+	my_uart_mmap_layout(port);
+	WRITE_ONCE(port->rx_overflow, rc->rx_overflow);
+out:
+	mutex_unlock(&port->cfg_lock);
+out_user:
+	mutex_unlock(&txrb->user);
+	mutex_unlock(&rxrb->user);
+	/* The old buffers on success, the unused new ones on failure */
+	vfree(rx_err);
+	vfree(rxbuf);
+	vfree(txbuf);
+	return ret;
+}
+
+/* ---- RX timestamp controls ---- */
+static int my_uart_set_rx_ts(struct my_uart_port *port, u32 on)
+{
+	if (mutex_lock_interruptible(&port->rxrb.user))
+		return -ERESTARTSYS;
+	/* The stamp ring has one consumer; fan-out readers would each need their own */
+	if (on && port->fanout) {
+		mutex_unlock(&port->rxrb.user);
+		return -EBUSY;
+	}
+	/* Stamps from an earlier session would land on the wrong bytes */
+	WRITE_ONCE(port->rx_ts_on, !!on);
+	my_uart_rx_ts_flush(port);
+	mutex_unlock(&port->rxrb.user);
+	return 0;
+}
+
+/* ---- RX fan-out ---- */
+static int my_uart_set_fanout(struct my_uart_port *port, u32 on)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	if (mutex_lock_interruptible(&port->rxrb.user))
+		return -ERESTARTSYS;
+	mutex_lock(&port->cfg_lock);
+	if (!!on == port->fanout)
+		goto out;
+	/* An mmap() consumer moves rxrb.tail itself; stamps are single-consumer */
+	if (atomic_read(&port->mmap_count) || port->rx_ts_on) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	/* Either way, what is queued belongs to the other mode: drop it */
+	spin_lock_irqsave(&port->rx_lock, flags);
+	WRITE_ONCE(port->fanout, !!on);
+	smp_store_release(&port->rxrb.ix->tail, port->rxrb.ix->head);
+	WRITE_ONCE(port->rx_gen, port->rx_gen + 1);
+	spin_unlock_irqrestore(&port->rx_lock, flags);
+	my_uart_rx_unthrottle(port);
+	/* Fan-out readers sleep without rxrb.user; let them see the switch */
+	wake_up_interruptible(&port->rx_wq);
+out:
+	mutex_unlock(&port->cfg_lock);
+	mutex_unlock(&port->rxrb.user);
+	return ret;
+}
+
+static int my_uart_get_fanout_stats(struct my_uart_file *f, struct my_uart_fanout_stats *st)
+{
+	struct my_uart_port *port = f->port;
+
+	memset(st, 0, sizeof(*st));
+	if (mutex_lock_interruptible(&port->rxrb.user))
+		return -EINTR;
+	st->overruns = f->rx_overruns;
+	st->lost = f->rx_lost;
+	if (port->fanout && f->rx_gen == port->rx_gen)
+		st->lag = min(port->rxrb.ix->head - f->rx_pos, port->rxrb.size);
+	mutex_unlock(&port->rxrb.user);
+	return 0;
+}
+
+static int my_uart_read_ts(struct my_uart_port *port, struct file *file,
+			   struct my_uart_read_ts __user *argp)
+{
+	struct my_uart_read_ts rt;
+	struct my_uart_read_req req = { };
+	struct iov_iter to;
+	ssize_t ret;
+
+	if (copy_from_user(&rt, argp, sizeof(rt)))
+		return -EFAULT;
+	if (port->framing != MY_UART_FRAMING_NONE)
+		return -EINVAL;
+	ret = import_ubuf(ITER_DEST, u64_to_user_ptr(rt.data), rt.data_len, &to);
+	if (ret)
+		return ret;
+
+	req.ts = u64_to_user_ptr(rt.ts);
+	req.ts_max = rt.ts_len;
+	ret = my_uart_read(file->private_data, &to, &req, file->f_flags & O_NONBLOCK);
+	if (ret < 0)
+		return ret;
+
+	rt.data_len = ret;
+	rt.ts_len = req.ts_filled;
+	return copy_to_user(argp, &rt, sizeof(rt)) ? -EFAULT : 0;
+}
+
+static int my_uart_read_err(struct my_uart_port *port, struct file *file,
+			    struct my_uart_read_err __user *argp)
+{
+	struct my_uart_read_err re;
+	struct my_uart_read_req req = { };
+	struct iov_iter to;
+	ssize_t ret;
+
+	if (copy_from_user(&re, argp, sizeof(re)))
+		return -EFAULT;
+	if (port->framing != MY_UART_FRAMING_NONE)
+		return -EINVAL;
+	ret = import_ubuf(ITER_DEST, u64_to_user_ptr(re.data), re.data_len, &to);
+	if (ret)
+		return ret;
+
+	req.err = u64_to_user_ptr(re.err);
+	ret = my_uart_read(file->private_data, &to, &req, file->f_flags & O_NONBLOCK);
+	if (ret < 0)
+		return ret;
+
+	re.data_len = ret;
+	re.err_bytes = req.err_bytes;
+	return copy_to_user(argp, &re, sizeof(re)) ? -EFAULT : 0;
+}
+
+static void my_uart_get_frame_stats(struct my_uart_port *port, struct my_uart_frame_stats *st)
+{
+	struct my_uart_stats s = port->stats;
+
+	memset(st, 0, sizeof(*st));
+	st->rx_frames = s.rx_frames;
+	st->tx_frames = s.tx_frames;
+	st->rx_crc_errs = s.rx_crc_errs;
+	st->rx_bad_frames = s.rx_bad_frames;
+	st->rx_dropped_frames = s.rx_dropped_frames;
+}
+
+static long my_uart3_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct my_uart_file *f = file->private_data;
+	struct my_uart_port *port = f->port;
+	void __user *argp = (void __user *)arg;
+
+	if (my_uart_dead(port))
+		return -ENODEV;
+
+	switch (cmd) {
+	case MY_UART_IOC_GET_COALESCE: {
+		struct my_uart_coalesce c;
+
+		my_uart_get_coalesce(port, &c);
+		return copy_to_user(argp, &c, sizeof(c)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_SET_COALESCE: {
+		struct my_uart_coalesce c;
+
+		if (copy_from_user(&c, argp, sizeof(c)))
+			return -EFAULT;
+		return my_uart_set_coalesce(port, &c);
+	}
+	case MY_UART_IOC_GET_IRQ_STATS: {
+		struct my_uart_irq_stats st;
+
+		my_uart_get_irq_stats(port, &st);
+		return copy_to_user(argp, &st, sizeof(st)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_GET_LINE: {
+		struct my_uart_line_info info;
+
+		mutex_lock(&port->cfg_lock);
+		my_uart_get_line(port, &info);
+		mutex_unlock(&port->cfg_lock);
+		return copy_to_user(argp, &info, sizeof(info)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_SET_LINE: {
+		struct my_uart_line_info info;
+		int ret;
+
+		if (copy_from_user(&info, argp, sizeof(info)))
+			return -EFAULT;
+		ret = my_uart_set_line(port, &info.cfg);
+		if (ret)
+			return ret;
+		mutex_lock(&port->cfg_lock);
+		my_uart_get_line(port, &info);
+		mutex_unlock(&port->cfg_lock);
+		return copy_to_user(argp, &info, sizeof(info)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_GET_FRAMING: {
+		u32 mode = port->framing;
+
+		return put_user(mode, (u32 __user *)argp);
+	}
+	case MY_UART_IOC_SET_FRAMING: {
+		u32 mode;
+
+		if (get_user(mode, (u32 __user *)argp))
+			return -EFAULT;
+		return my_uart_set_framing(port, mode);
+	}
+	case MY_UART_IOC_GET_FRAME_STATS: {
+		struct my_uart_frame_stats st;
+
+		my_uart_get_frame_stats(port, &st);
+		return copy_to_user(argp, &st, sizeof(st)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_GET_RX_TS:
+		return put_user((u32)READ_ONCE(port->rx_ts_on), (u32 __user *)argp);
+	case MY_UART_IOC_SET_RX_TS: {
+		u32 on;
+
+		if (get_user(on, (u32 __user *)argp))
+			return -EFAULT;
+		return my_uart_set_rx_ts(port, on);
+	}
+	case MY_UART_IOC_READ_TS:
+		return my_uart_read_ts(port, file, argp);
+	case MY_UART_IOC_READ_ERR:
+		return my_uart_read_err(port, file, argp);
+	case MY_UART_IOC_GET_MMAP_LEN: {
+		u32 len;
+
+		mutex_lock(&port->cfg_lock);
+		len = my_uart_mmap_len(port);
+		mutex_unlock(&port->cfg_lock);
+		return put_user(len, (u32 __user *)argp);
+	}
+	case MY_UART_IOC_GET_RING: {
+		struct my_uart_ring_cfg rc;
+
+		mutex_lock(&port->cfg_lock);
+		my_uart_get_ring(port, &rc);
+		mutex_unlock(&port->cfg_lock);
+		return copy_to_user(argp, &rc, sizeof(rc)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_SET_RING: {
+		struct my_uart_ring_cfg rc;
+
+		if (copy_from_user(&rc, argp, sizeof(rc)))
+			return -EFAULT;
+		return my_uart_set_ring(port, &rc);
+	}
+	case MY_UART_IOC_GET_BUSY_POLL: {
+		struct my_uart_busy_poll bp = {
+			.budget_us = READ_ONCE(f->busy_poll_us),
+			.polls = f->busy_polls,
+			.hits = f->busy_poll_hits,
+			.drained = f->busy_poll_drained,
+		};
+
+		return copy_to_user(argp, &bp, sizeof(bp)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_SET_BUSY_POLL: {
+		u32 us;
+
+		if (get_user(us, (u32 __user *)argp))
+			return -EFAULT;
+		if (us > MY_UART_BUSY_POLL_MAX_US)
+			return -EINVAL;
+		/* A read() already sleeping keeps sleeping */
+		WRITE_ONCE(f->busy_poll_us, us);
+		return 0;
+	}
+	case MY_UART_IOC_GET_FANOUT:
+		return put_user((u32)READ_ONCE(port->fanout), (u32 __user *)argp);
+	case MY_UART_IOC_SET_FANOUT: {
+		u32 on;
+
+		if (get_user(on, (u32 __user *)argp))
+			return -EFAULT;
+		return my_uart_set_fanout(port, on);
+	}
+	case MY_UART_IOC_GET_FANOUT_STATS: {
+		struct my_uart_fanout_stats st;
+		int ret;
+
+		ret = my_uart_get_fanout_stats(f, &st);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &st, sizeof(st)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_GET_WAKE: {
+		struct my_uart_wake wk = {
+			.min = READ_ONCE(f->vmin),
+			.time_us = READ_ONCE(f->vtime_us),
+		};
+		int eol = READ_ONCE(f->eol);
+
+		if (eol >= 0) {
+			wk.eol = eol;
+			wk.eol_on = 1;
+		}
+		return copy_to_user(argp, &wk, sizeof(wk)) ? -EFAULT : 0;
+	}
+	case MY_UART_IOC_SET_WAKE: {
+		struct my_uart_wake wk;
+
+		if (copy_from_user(&wk, argp, sizeof(wk)))
+			return -EFAULT;
+		/* A read() already sleeping keeps the conditions it started with */
+		WRITE_ONCE(f->vmin, wk.min);
+		WRITE_ONCE(f->vtime_us, wk.time_us);
+		WRITE_ONCE(f->eol, wk.eol_on ? wk.eol : -1);
+		return 0;
+	}
+	case MY_UART_IOC_GET_IDLE_GAP:
+		return put_user(READ_ONCE(port->idle_gap_us), (u32 __user *)argp);
+	case MY_UART_IOC_SET_IDLE_GAP: {
+		u32 us;
+
+		if (get_user(us, (u32 __user *)argp))
+			return -EFAULT;
+		/* Taken at the next drain; a burst in progress keeps its gap */
+		WRITE_ONCE(port->idle_gap_us, us);
+		return 0;
+	}
+	default:
+		return -ENOTTY;
+	}
+}
+
+static ssize_t rx_trigger_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", ifls_eighths[port->rx_ifls]);
+}
+
+static ssize_t rx_trigger_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t len)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	struct my_uart_coalesce c;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+	my_uart_get_coalesce(port, &c);
+	c.rx_trigger = val;
+	ret = my_uart_set_coalesce(port, &c);
+	return ret ? ret : len;
+}
+static DEVICE_ATTR_RW(rx_trigger);
+
+static ssize_t tx_trigger_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", ifls_eighths[port->tx_ifls]);
+}
+
+static ssize_t tx_trigger_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t len)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	struct my_uart_coalesce c;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+	my_uart_get_coalesce(port, &c);
+	c.tx_trigger = val;
+	ret = my_uart_set_coalesce(port, &c);
+	return ret ? ret : len;
+}
+static DEVICE_ATTR_RW(tx_trigger);
+
+static ssize_t adaptive_rx_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", port->adaptive_rx);
+}
+
+static ssize_t adaptive_rx_store(struct device *dev, struct device_attribute *attr,
+				 const char *buf, size_t len)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	struct my_uart_coalesce c;
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret)
+		return ret;
+	my_uart_get_coalesce(port, &c);
+	c.adaptive_rx = val;
+	ret = my_uart_set_coalesce(port, &c);
+	return ret ? ret : len;
+}
+static DEVICE_ATTR_RW(adaptive_rx);
+
+static ssize_t irqs_per_kb_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	struct my_uart_irq_stats st;
+
+	my_uart_get_irq_stats(port, &st);
+	return sysfs_emit(buf, "rx %u tx %u\n", st.rx_irqs_per_kb, st.tx_irqs_per_kb);
+}
+static DEVICE_ATTR_RO(irqs_per_kb);
+
+/* Threaded mode only; the thread picks changes up at its next interrupt */
+static ssize_t irq_thread_prio_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(port->thread_prio));
+}
+
+static ssize_t irq_thread_prio_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t len)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	int val, ret;
+
+	if (!port->threaded)
+		return -ENODEV;
+	ret = kstrtoint(buf, 0, &val);
+	if (ret)
+		return ret;
+	if (val < 0 || val >= MAX_RT_PRIO)
+		return -EINVAL;
+
+	mutex_lock(&port->thread_lock);
+	port->thread_prio = val;
+	mutex_unlock(&port->thread_lock);
+	atomic_set(&port->thread_setup, 1);
+	return len;
+}
+static DEVICE_ATTR_RW(irq_thread_prio);
+
+static ssize_t irq_thread_cpus_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	ssize_t ret;
+
+	mutex_lock(&port->thread_lock);
+	ret = sysfs_emit(buf, "%*pbl\n", cpumask_pr_args(&port->thread_cpus));
+	mutex_unlock(&port->thread_lock);
+	return ret;
+}
+
+static ssize_t irq_thread_cpus_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t len)
+{
+	struct my_uart_port *port = dev_get_drvdata(dev);
+	cpumask_var_t cpus;
+	int ret;
+
+	if (!port->threaded)
+		return -ENODEV;
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return -ENOMEM;
+	ret = cpulist_parse(buf, cpus);
+	if (!ret && !cpumask_empty(cpus) && !cpumask_intersects(cpus, cpu_online_mask))
+		ret = -EINVAL;
+	if (!ret) {
+		mutex_lock(&port->thread_lock);
+		cpumask_copy(&port->thread_cpus, cpus);
+		mutex_unlock(&port->thread_lock);
+		atomic_set(&port->thread_setup, 1);
+	}
+	free_cpumask_var(cpus);
+	return ret ? ret : len;
+}
+static DEVICE_ATTR_RW(irq_thread_cpus);
+
+static struct attribute *my_uart_attrs[] = {
+	&dev_attr_rx_trigger.attr,
+	&dev_attr_tx_trigger.attr,
+	&dev_attr_adaptive_rx.attr,
+	&dev_attr_irqs_per_kb.attr,
+	&dev_attr_irq_thread_prio.attr,
+	&dev_attr_irq_thread_cpus.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(my_uart);
+
+/* ---- mmap of the rings ---- */
+/* vm_file keeps the file, and so the port, until the last VMA goes */
+static void my_uart_vm_open(struct vm_area_struct *vma)
+{
+	struct my_uart_port *port = vma->vm_private_data;
+
+	atomic_inc(&port->mmap_count);
+}
+
+static void my_uart_vm_close(struct vm_area_struct *vma)
+{
+	struct my_uart_port *port = vma->vm_private_data;
+
+	atomic_dec(&port->mmap_count);
+}
+
+static const struct vm_operations_struct my_uart_vm_ops = {
+	.open  = my_uart_vm_open,
+	.close = my_uart_vm_close,
+};
+
+/* The buffers are vmalloc_user() memory: insert them page by page */
+static int my_uart_mmap_area(struct vm_area_struct *vma, unsigned long addr,
+			     void *buf, unsigned long len)
+{
+	unsigned long off;
+	int ret;
+
+	for (off = 0; off < len; off += PAGE_SIZE) {
+		ret = vm_insert_page(vma, addr + off, vmalloc_to_page(buf + off));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int my_uart3_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct my_uart_file *f = file->private_data;
+	struct my_uart_port *port = f->port;
+	unsigned long start = vma->vm_start;
+	int ret;
+
+	if (vma->vm_pgoff || !(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	mutex_lock(&port->cfg_lock);
+	if (port->dead) {
+		ret = -ENODEV;
+		goto out;
+	}
+	if (vma->vm_end - start != my_uart_mmap_len(port)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	/* The mapping would be one more consumer of rxrb.tail, which fan-out gives the producer */
+	if (port->fanout) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+	ret = my_uart_mmap_area(vma, start, port->ctrl, PAGE_SIZE);
+	if (!ret)
+		ret = my_uart_mmap_area(vma, start + port->ctrl->rx.offset,
+					port->rxrb.buf, rb_map_len(&port->rxrb));
+	if (!ret)
+		ret = my_uart_mmap_area(vma, start + port->ctrl->tx.offset,
+					port->txrb.buf, rb_map_len(&port->txrb));
+	if (ret)
+		goto out;
+
+	vma->vm_private_data = port;
+	vma->vm_ops = &my_uart_vm_ops;
+	my_uart_vm_open(vma);
+out:
+	mutex_unlock(&port->cfg_lock);
+	return ret;
+}
+
+static int my_uart3_release(struct inode *inode, struct file *file)
+{
+	struct my_uart_file *f = file->private_data;
+	struct my_uart_port *port = f->port;
+
+	mutex_lock(&port->cfg_lock);
+	/* After my_uart_remove() the UART is already off */
+	if (!--port->open_count && !port->dead)
+		my_uart_shutdown(port);
+	mutex_unlock(&port->cfg_lock);
+	kfree(f);
+	return 0;
+}
+
+static const struct file_operations my_uart3_fops = {
+	.owner   = THIS_MODULE,
+	.open    = my_uart3_open,
+	.read_iter = my_uart3_read_iter,
+	.write_iter = my_uart3_write_iter,
+	/* Pipe pages go through the iov_iter paths: no bounce via userspace */
+	.splice_read = copy_splice_read,
+	.splice_write = iter_file_splice_write,
+	.poll    = my_uart3_poll,
+	.mmap    = my_uart3_mmap,
+	.unlocked_ioctl = my_uart3_ioctl,
+	.compat_ioctl   = compat_ptr_ioctl,
+	.release = my_uart3_release,
+};
+
+/* ---- debugfs: counters and histograms, write anything to reset ---- */
+static void my_uart_hist_show(struct seq_file *m, const char *name, const u32 *hist)
+{
+	int i;
+
+	seq_printf(m, "%s:\n", name);
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == 0)
+			seq_printf(m, "  %10u : %u\n", 0, hist[i]);
+		else
+			seq_printf(m, "  %10llu : %u\n", 1ULL << (i - 1), hist[i]);
+	}
+}
+
+static int my_uart_stats_show(struct seq_file *m, void *v)
+{
+	struct my_uart_port *port = m->private;
+	struct my_uart_stats *s = &port->stats;
+
+	seq_printf(m, "isr_calls:     %llu\n", s->isr_calls);
+	seq_printf(m, "rx_irqs:       %llu\n", s->rx_irqs);
+	seq_printf(m, "rt_irqs:       %llu\n", s->rt_irqs);
+	seq_printf(m, "tx_irqs:       %llu\n", s->tx_irqs);
+	seq_printf(m, "rx_bytes:      %llu\n", s->rx_bytes);
+	seq_printf(m, "tx_bytes:      %llu\n", s->tx_bytes);
+	seq_printf(m, "rx_dropped:    %llu\n", s->rx_dropped);
+	seq_printf(m, "rx_throttles:  %llu\n", s->rx_throttles);
+	seq_printf(m, "rx_frames:     %llu\n", s->rx_frames);
+	seq_printf(m, "tx_frames:     %llu\n", s->tx_frames);
+	seq_printf(m, "rx_crc_errs:   %llu\n", s->rx_crc_errs);
+	seq_printf(m, "rx_bad_frames: %llu\n", s->rx_bad_frames);
+	seq_printf(m, "rx_dropped_frames: %llu\n", s->rx_dropped_frames);
+	seq_printf(m, "rx_ts_overflows: %llu\n", s->rx_ts_overflows);
+	seq_printf(m, "isr_max_ns:    %llu\n", s->isr_max_ns);
+	if (port->threaded)
+		seq_printf(m, "irq_wake_max_ns: %llu\n", s->irq_wake_max_ns);
+	seq_printf(m, "busy_polls:    %lld\n", atomic64_read(&s->busy_polls));
+	seq_printf(m, "busy_poll_hits: %lld\n", atomic64_read(&s->busy_poll_hits));
+	seq_printf(m, "overrun_errs:  %llu\n", s->overrun_errs);
+	seq_printf(m, "frame_errs:    %llu\n", s->frame_errs);
+	seq_printf(m, "parity_errs:   %llu\n", s->parity_errs);
+	seq_printf(m, "break_errs:    %llu\n", s->break_errs);
+	seq_printf(m, "bytes_per_isr: %llu\n",
+		   s->isr_calls ? div64_u64(s->rx_bytes + s->tx_bytes, s->isr_calls) : 0);
+	seq_printf(m, "rx_high_water: %u/%u\n", s->rx_high_water, port->rxrb.size);
+	seq_printf(m, "tx_high_water: %u/%u\n", s->tx_high_water, port->txrb.size);
+	seq_printf(m, "rx_overflow:   %u\n", READ_ONCE(port->rx_overflow));
+	seq_printf(m, "fanout:        %u\n", READ_ONCE(port->fanout));
+	return 0;
+}
+
+static int my_uart_hist_all_show(struct seq_file *m, void *v)
+{
+	struct my_uart_port *port = m->private;
+
+	my_uart_hist_show(m, "isr_ns", port->hist.isr_ns);
+	if (port->threaded)
+		my_uart_hist_show(m, "irq_wake_ns", port->hist.irq_wake_ns);
+	my_uart_hist_show(m, "bytes_per_isr", port->hist.bytes_per_isr);
+	my_uart_hist_show(m, "rx_fill", port->hist.rx_fill);
+	my_uart_hist_show(m, "tx_fill", port->hist.tx_fill);
+	return 0;
+}
+
+static int my_uart_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, my_uart_stats_show, inode->i_private);
+}
+
+static int my_uart_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, my_uart_hist_all_show, inode->i_private);
+}
+
+static ssize_t my_uart_stats_reset(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct my_uart_port *port = ((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->lock, flags);
+	memset(&port->stats, 0, sizeof(port->stats));
+	memset(&port->hist, 0, sizeof(port->hist));
+	memset(&port->adapt_base, 0, sizeof(port->adapt_base));
+	spin_unlock_irqrestore(&port->lock, flags);
+	return count;
+}
+
+static const struct file_operations my_uart_stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = my_uart_stats_open,
+	.read    = seq_read,
+	.write   = my_uart_stats_reset,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static const struct file_operations my_uart_hist_fops = {
+	.owner   = THIS_MODULE,
+	.open    = my_uart_hist_open,
+	.read    = seq_read,
+	.write   = my_uart_stats_reset,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static void my_uart_debugfs_init(struct my_uart_port *port)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), DEVICE_NAME "%u", port->line);
+	port->debugfs = debugfs_create_dir(name, my_uart_debugfs_root);
+	debugfs_create_file("stats", 0600, port->debugfs, port, &my_uart_stats_fops);
+	debugfs_create_file("histograms", 0600, port->debugfs, port, &my_uart_hist_fops);
+}
+
+/* ---- Platform driver ---- */
+/* vmalloc_user(): zeroed, and each page can go to vm_insert_page() for mmap() */
+static int my_uart_ring_init(struct ring *r, struct my_uart_mmap_ring *ix, unsigned int size)
+{
+	r->buf = vmalloc_user(size);
+	if (!r->buf)
+		return -ENOMEM;
+	r->ix = ix;
+	r->size = size;
+	ix->size = size;
+	mutex_init(&r->user);
+	return 0;
+}
+
+/* cdev_dev release, once the last file and VMA are gone */
+static void my_uart_port_release(struct device *dev)
+{
+	struct my_uart_port *port = container_of(dev, struct my_uart_port, cdev_dev);
+
+	/* Whatever buffers MY_UART_IOC_SET_RING left in place */
+	vfree(port->rx_err[0]);
+	vfree(port->rxrb.buf);
+	vfree(port->txrb.buf);
+	vfree(port->ctrl);
+	kfree(port);
+}
+
+/* devm action: drop probe's reference, after my_uart_remove() */
+static void my_uart_port_put(void *data)
+{
+	struct my_uart_port *port = data;
+
+	put_device(&port->cdev_dev);
+}
+
+static int my_uart_rings_init(struct my_uart_port *port)
+{
+	struct device *dev = port->dev;
+	int ret;
+
+	if (!my_uart_ring_size_ok(rx_ring_size)) {
+		dev_warn(dev, "rx_ring_size %u invalid, using %u\n", rx_ring_size, MY_UART_RING_MIN);
+		rx_ring_size = MY_UART_RING_MIN;
+	}
+	if (!my_uart_ring_size_ok(tx_ring_size)) {
+		dev_warn(dev, "tx_ring_size %u invalid, using %u\n", tx_ring_size, MY_UART_RING_MIN);
+		tx_ring_size = MY_UART_RING_MIN;
+	}
+
+	port->ctrl = vmalloc_user(PAGE_SIZE);
+	if (!port->ctrl)
+		return -ENOMEM;
+	ret = my_uart_ring_init(&port->rxrb, &port->ctrl->rx, rx_ring_size);
+	if (!ret)
+		ret = my_uart_ring_init(&port->txrb, &port->ctrl->tx, tx_ring_size);
+	if (ret)
+		return ret;
+	my_uart_mmap_layout(port);
+
+	port->rx_err[0] = my_uart_rx_err_alloc(port->rxrb.size);
+	if (!port->rx_err[0])
+		return -ENOMEM;
+	my_uart_rx_err_set(port, port->rx_err[0]);
+	return 0;
+}
+
+static int my_uart_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct my_uart_port *port;
+	struct resource *res;
+	dev_t devt;
+	int ret;
+
+	/* Not devm: open files keep it past my_uart_remove(), see my_uart_port_release() */
+	port = kzalloc(sizeof(*port), GFP_KERNEL);
+	if (!port)
+		return -ENOMEM;
+	device_initialize(&port->cdev_dev);
+	port->cdev_dev.release = my_uart_port_release;
+	ret = devm_add_action_or_reset(dev, my_uart_port_put, port);
+	if (ret)
+		return ret;
+	port->dev = dev;
+
+	port->base = devm_platform_get_and_ioremap_resource(pdev, 0, &res);
+	if (IS_ERR(port->base))
+		return PTR_ERR(port->base);
+	port->mapbase = res->start;
+	port->line = MY_UART_LINE(res->start);
+	if (port->line >= MY_UART_MAX_PORTS)
+		return dev_err_probe(dev, -EINVAL, "unexpected base %pa\n", &res->start);
+
+	port->irq = platform_get_irq(pdev, 0);
+	if (port->irq < 0)
+		return port->irq;
+
+	ret = my_uart_rings_init(port);
+	if (ret)
+		return ret;
+	/* UARTCLK comes from the clock framework; fall back to the rpi4 default */
+	/* Enabled from first open to last release */
+	port->clk = devm_clk_get_optional(dev, "uartclk");
+	if (IS_ERR(port->clk))
+		return dev_err_probe(dev, PTR_ERR(port->clk), "uartclk\n");
+	port->uartclk = clk_get_rate(port->clk);
+	if (!port->uartclk)
+		port->uartclk = UARTCLK_DEFAULT;
+
+	port->line_cfg.baud = baudrate;
+	port->line_cfg.data_bits = 8;
+	port->line_cfg.parity = MY_UART_PARITY_NONE;
+	port->line_cfg.stop_bits = 1;
+	/* With RTS/CTS, stalling the FIFO pushes back on the peer instead of losing data */
+	if (device_property_read_bool(dev, "uart-has-rtscts")) {
+		port->line_cfg.flow = MY_UART_FLOW_RTSCTS;
+		port->rx_overflow = MY_UART_OVERFLOW_BLOCK;
+	}
+	ret = my_uart_calc_divisor(port->uartclk, baudrate, &port->ibrd, &port->fbrd);
+	if (ret)
+		return dev_err_probe(dev, ret, "baudrate %d out of range for uartclk %lu\n",
+				     baudrate, port->uartclk);
+
+	mutex_init(&port->cfg_lock);
+	spin_lock_init(&port->lock);
+	raw_spin_lock_init(&port->irq_lock);
+	mutex_init(&port->thread_lock);
+	if (irq_thread_prio < 0 || irq_thread_prio >= MAX_RT_PRIO) {
+		dev_warn(dev, "irq_thread_prio %d out of range, using the default\n",
+			 irq_thread_prio);
+		irq_thread_prio = 0;
+	}
+	port->thread_prio = irq_thread_prio;
+	atomic_set(&port->thread_setup, 1);
+	spin_lock_init(&port->rx_lock);
+	spin_lock_init(&port->tx_lock);
+	/* Not _HARD: on PREEMPT_RT the callback's rx_lock is a sleeping lock */
+	hrtimer_init(&port->idle_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	port->idle_timer.function = my_uart_idle_timer;
+	port->rx_ifls = IFLS_HALF;
+	port->tx_ifls = IFLS_HALF;
+	init_waitqueue_head(&port->rx_wq);
+	init_waitqueue_head(&port->tx_wq);
+
+	/* Quiet until first open */
+	writel(0x0, port->base + UART_IMSC);
+	writel(0x7FF, port->base + UART_ICR);
+
+	if (use_dma) {
+		ret = uart_dma_setup(port);
+		if (ret == -EPROBE_DEFER)
+			return ret;
+		if (ret)
+			dev_info(dev, "no DMA channels (%d), using PIO\n", ret);
+	}
+
+	port->threaded = threaded_irq;
+	if (port->threaded) {
+		/*
+		 * ONESHOT keeps the hard handler out of forced threading on
+		 * PREEMPT_RT, where every sharer of the line gets ONESHOT anyway;
+		 * elsewhere it would clash with the other PL011 drivers on it.
+		 */
+		ret = devm_request_threaded_irq(dev, port->irq, my_uart3_isr_hard,
+						my_uart3_irq_thread,
+						IRQF_SHARED | (IS_ENABLED(CONFIG_PREEMPT_RT) ?
+							       IRQF_ONESHOT : 0),
+						dev_name(dev), port);
+	} else {
+		ret = devm_request_irq(dev, port->irq, my_uart3_isr, IRQF_SHARED,
+				       dev_name(dev), port);
+	}
+	if (ret)
+		goto err_dma;
+
+	devt = MKDEV(MAJOR(my_uart_devt), port->line);
+	port->cdev_dev.class = my_uart_class;
+	port->cdev_dev.parent = dev;
+	port->cdev_dev.devt = devt;
+	port->cdev_dev.groups = my_uart_groups;
+	dev_set_drvdata(&port->cdev_dev, port);
+	ret = dev_set_name(&port->cdev_dev, DEVICE_NAME "%u", port->line);
+	if (ret)
+		goto err_dma;
+	cdev_init(&port->cdev, &my_uart3_fops);
+	port->cdev.owner = THIS_MODULE;
+	/* Makes cdev_dev the cdev's parent: each open file pins the port */
+	ret = cdev_device_add(&port->cdev, &port->cdev_dev);
+	if (ret)
+		goto err_dma;
+
+	platform_set_drvdata(pdev, port);
+	my_uart_debugfs_init(port);
+	dev_info(dev, "/dev/" DEVICE_NAME "%u (irq %d%s, base %pa, %s)\n",
+		 port->line, port->irq, port->threaded ? " threaded" : "", &port->mapbase,
+		 port->dma_active ? "dma" : "pio");
+	return 0;
+
+err_dma:
+	uart_dma_release(port);
+	return ret;
+}
+
+static void my_uart_remove(struct platform_device *pdev)
+{
+	struct my_uart_port *port = platform_get_drvdata(pdev);
+
+	debugfs_remove_recursive(port->debugfs);
+	/* No new opens; files already open keep the port, but not the device */
+	cdev_device_del(&port->cdev, &port->cdev_dev);
+
+	mutex_lock(&port->cfg_lock);
+	/* Dead RX drains leave the FIFO alone: mask first, or its level IRQ would storm */
+	if (port->open_count)
+		my_uart_imsc(port, ~0U, 0);
+	port->dead = true;
+	if (port->open_count)
+		my_uart_shutdown(port);
+	mutex_unlock(&port->cfg_lock);
+	/* A TX kick, RX drain or unthrottle past its dead check is done after these */
+	spin_lock_irq(&port->tx_lock);
+	spin_unlock_irq(&port->tx_lock);
+	spin_lock_irq(&port->rx_lock);
+	spin_unlock_irq(&port->rx_lock);
+	spin_lock_irq(&port->lock);
+	spin_unlock_irq(&port->lock);
+	wake_up_interruptible_all(&port->rx_wq);
+	wake_up_interruptible_all(&port->tx_wq);
+
+	/* Mask and clear all interrupts */
+	writel(0x0, port->base + UART_IMSC);
+	writel(0x7FF, port->base + UART_ICR);
+	writel(0x0, port->base + UART_DMACR);
+	synchronize_irq(port->irq);
+
+	uart_dma_release(port);
+	/* After the DMA RX callback and poll timer, which drain and may re-arm it */
+	hrtimer_cancel(&port->idle_timer);
+}
+
+static const struct of_device_id my_uart_of_match[] = {
+	{ .compatible = "jeong,my-uart" },
+	{ .compatible = "jeong,my-uart3" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, my_uart_of_match);
+
+static struct platform_driver my_uart_driver = {
+	.driver = {
+		.name = DEVICE_NAME,
+		.of_match_table = my_uart_of_match,
+	},
+	.probe  = my_uart_probe,
+	.remove = my_uart_remove,
+};
+
+/* ---- Module init/exit ---- */
+static int __init my_uart3_init(void)
+{
+	int ret;
+
+	if (baudrate <= 0)
+		return -EINVAL;
+
+	ret = alloc_chrdev_region(&my_uart_devt, 0, MY_UART_MAX_PORTS, DEVICE_NAME);
+	if (ret)
+		return ret;
+
+	my_uart_class = class_create(DEVICE_NAME);
+	if (IS_ERR(my_uart_class)) {
+		ret = PTR_ERR(my_uart_class);
+		goto err_region;
+	}
+
+	my_uart_debugfs_root = debugfs_create_dir(DEVICE_NAME, NULL);
+
+	ret = platform_driver_register(&my_uart_driver);
+	if (ret)
+		goto err_class;
+
+	pr_info("my_uart: loaded (major %d)\n", MAJOR(my_uart_devt));
+	return 0;
+
+err_class:
+	debugfs_remove_recursive(my_uart_debugfs_root);
+	class_destroy(my_uart_class);
+err_region:
+	unregister_chrdev_region(my_uart_devt, MY_UART_MAX_PORTS);
+	return ret;
+}
+
+static void __exit my_uart3_exit(void)
+{
+	platform_driver_unregister(&my_uart_driver);
+	debugfs_remove_recursive(my_uart_debugfs_root);
+	class_destroy(my_uart_class);
+	unregister_chrdev_region(my_uart_devt, MY_UART_MAX_PORTS);
 
-	pr_info("my_uart3: unloaded\n");
+	pr_info("my_uart: unloaded\n");
 }
 
 module_init(my_uart3_init);
@@ -303,4 +3714,4 @@ module_exit(my_uart3_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("jeong7231");
-MODULE_DESCRIPTION("Interrupt-based PL011 UART3 driver for BCM2711 (Raspberry Pi 4)");
+MODULE_DESCRIPTION("Interrupt-based PL011 UART driver for BCM2711 (Raspberry Pi 4)");
@@ -0,0 +1,225 @@
+/* ioctl ABI shared by my_uart3_dev.c and userspace (my_uart3_app.c) */
+#ifndef MY_UART3_IOCTL_H
+#define MY_UART3_IOCTL_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define MY_UART_IOC_MAGIC 'u'
+
+/* ---- Interrupt coalescing (PL011 IFLS trigger levels) ---- */
+struct my_uart_coalesce {
+	__u32 rx_trigger;	/* RX FIFO level in eighths: 1, 2, 4, 6 or 7 */
+	__u32 tx_trigger;	/* TX FIFO level in eighths: 1, 2, 4, 6 or 7 */
+	__u32 adaptive_rx;	/* non-zero: driver moves rx_trigger with traffic */
+	__u32 reserved;
+};
+
+struct my_uart_irq_stats {
+	__u64 rx_irqs;		/* RX FIFO level interrupts */
+	__u64 rt_irqs;		/* RX timeout interrupts */
+	__u64 tx_irqs;
+	__u64 rx_bytes;
+	__u64 tx_bytes;
+	__u32 rx_irqs_per_kb;	/* (rx_irqs + rt_irqs) per 1024 RX bytes */
+	__u32 tx_irqs_per_kb;
+};
+
+/* ---- Line settings (termios-like, applied at runtime) ---- */
+#define MY_UART_PARITY_NONE 0
+#define MY_UART_PARITY_ODD  1
+#define MY_UART_PARITY_EVEN 2
+
+#define MY_UART_FLOW_NONE   0
+#define MY_UART_FLOW_RTSCTS 1	/* PL011 RTSEn/CTSEn plus ring-level RX throttling */
+
+struct my_uart_line_cfg {
+	__u32 baud;		/* requested bits per second */
+	__u8 data_bits;		/* 5..8 */
+	__u8 parity;		/* MY_UART_PARITY_* */
+	__u8 stop_bits;		/* 1 or 2 */
+	__u8 flow;		/* MY_UART_FLOW_* */
+};
+
+/* SET takes cfg and returns the rest; GET fills everything */
+struct my_uart_line_info {
+	struct my_uart_line_cfg cfg;
+	__u32 actual_baud;	/* what IBRD/FBRD really produce */
+	__s32 error_ppm;	/* (actual - requested) / requested, parts per million */
+	__u32 uartclk;		/* Hz, from the clock framework */
+	__u16 ibrd;
+	__u16 fbrd;
+};
+
+/* ---- Framing: one frame per read()/write() ---- */
+#define MY_UART_FRAMING_NONE 0	/* byte stream */
+#define MY_UART_FRAMING_SLIP 1	/* RFC 1055 SLIP, CRC-16/X.25 trailer (LSB first) */
+#define MY_UART_FRAMING_IDLE 2	/* bursts delimited by RX line silence (Modbus RTU) */
+
+#define MY_UART_FRAME_MAX 256	/* payload bytes, CRC not included */
+
+struct my_uart_frame_stats {
+	__u64 rx_frames;	/* good frames queued for read() */
+	__u64 tx_frames;
+	__u64 rx_crc_errs;
+	__u64 rx_bad_frames;	/* too short/long, bad escape or line error */
+	__u64 rx_dropped_frames;	/* good frame, but no room in the RX ring */
+};
+
+/* ---- RX timestamps (byte stream mode) ---- */
+/* Bytes from offset on arrived in one batch, drained at ns (CLOCK_MONOTONIC) */
+struct my_uart_rx_ts {
+	__u32 offset;		/* into the data returned by the same call */
+	__u32 reserved;
+	__u64 ns;
+};
+
+/* recvmsg-like: read() plus the stamps of the batches the data came in */
+struct my_uart_read_ts {
+	__u64 data;		/* user pointer to the data buffer */
+	__u64 ts;		/* user pointer to struct my_uart_rx_ts[] */
+	__u32 data_len;		/* in: buffer size, out: bytes read */
+	__u32 ts_len;		/* in: array entries, out: entries filled */
+};
+
+/* ---- Per-byte line errors (PIO byte stream mode) ---- */
+/* Same order as PL011 DR bits 8..11 */
+#define MY_UART_ERR_FE 0x01	/* framing */
+#define MY_UART_ERR_PE 0x02	/* parity */
+#define MY_UART_ERR_BE 0x04	/* break */
+#define MY_UART_ERR_OE 0x08	/* FIFO overrun before this byte */
+
+/* read() plus one MY_UART_ERR_* byte per data byte */
+struct my_uart_read_err {
+	__u64 data;		/* user pointer to the data buffer */
+	__u64 err;		/* user pointer to data_len flag bytes */
+	__u32 data_len;		/* in: buffer size, out: bytes read */
+	__u32 err_bytes;	/* out: how many of them have a flag set */
+};
+
+/*
+ * ---- mmap: control page, RX ring, TX ring ----
+ * Map MY_UART_IOC_GET_MMAP_LEN bytes at offset 0, MAP_SHARED. Indices run
+ * free; byte i of a ring is at offset + (i & (size - 1)). Load the other
+ * side's index with acquire and store your own with release. While the
+ * mapping exists read() and write() fail with EBUSY; poll() kicks TX and
+ * lets RX flow again, so it doubles as the doorbell. Under
+ * MY_UART_OVERFLOW_DROP_OLDEST the driver moves rx.tail too: advance it
+ * with compare-and-swap and re-read the data if that fails.
+ */
+struct my_uart_mmap_ring {
+	__u32 head;		/* producer index */
+	__u32 tail;		/* consumer index */
+	__u32 size;		/* bytes, power of two */
+	__u32 offset;		/* of the data from the start of the mapping */
+};
+
+struct my_uart_mmap_ctrl {
+	struct my_uart_mmap_ring rx;	/* driver produces, the mapping consumes */
+	__u8 pad[64 - sizeof(struct my_uart_mmap_ring)];	/* own cache line each */
+	struct my_uart_mmap_ring tx;	/* the mapping produces, driver consumes */
+};
+
+/* ---- Ring sizes and RX overflow policy ---- */
+#define MY_UART_RING_MIN 1024
+#define MY_UART_RING_MAX (4 << 20)
+
+#define MY_UART_OVERFLOW_DROP_NEWEST 0	/* keep what is queued, lose the new bytes */
+#define MY_UART_OVERFLOW_DROP_OLDEST 1	/* recycle the oldest queued bytes/frames */
+#define MY_UART_OVERFLOW_BLOCK       2	/* stop draining the FIFO (pair with RTS/CTS) */
+/*
+ * With DMA, BLOCK needs MY_UART_FLOW_RTSCTS: the cyclic RX transfer cannot
+ * be held back, only the peer can. SET_RING and SET_LINE refuse (EINVAL)
+ * whichever change would leave BLOCK without it.
+ */
+
+/*
+ * SET: an RX resize discards what rxrb holds; a TX resize first waits for
+ * txrb to drain (ETIMEDOUT if it does not). A ring keeping its size keeps
+ * its data, so a policy-only change touches neither. EBUSY while mmap()ed.
+ */
+struct my_uart_ring_cfg {
+	__u32 rx_size;		/* bytes, power of two, MY_UART_RING_MIN..MAX */
+	__u32 tx_size;
+	__u8 rx_overflow;	/* MY_UART_OVERFLOW_* */
+	__u8 reserved[3];
+};
+
+/* ---- Busy-poll read (per open file, like SO_BUSY_POLL) ---- */
+#define MY_UART_BUSY_POLL_MAX_US 10000
+
+/*
+ * Before read() sleeps on an empty ring it spins for up to budget_us,
+ * pulling the RX FIFO (or the DMA buffer) itself instead of waiting for
+ * the interrupt. Counters are this file's and start at zero on open().
+ */
+struct my_uart_busy_poll {
+	__u32 budget_us;	/* 0: off (default), up to MY_UART_BUSY_POLL_MAX_US */
+	__u32 reserved;
+	__u64 polls;		/* reads that found the ring empty and spun */
+	__u64 hits;		/* ... and got data before the budget ran out */
+	__u64 drained;		/* ... of those, data the spin moved itself, not the IRQ */
+};
+
+/*
+ * ---- RX fan-out: every open file reads the whole stream ----
+ * With SET_FANOUT 1 each open file has its own cursor on the one RX ring,
+ * starting where the ring stood at open(). Nobody waits for a slow reader:
+ * the driver recycles the oldest bytes or frames (rx_overflow is ignored),
+ * and a reader it overtook gets EPIPE once, then carries on with the oldest
+ * data still queued. Switching drops what is queued; EBUSY while mmap()ed
+ * or with RX timestamps on.
+ */
+struct my_uart_fanout_stats {
+	__u64 overruns;		/* EPIPEs this file got */
+	__u64 lost;		/* bytes skipped by them (framed: record headers included) */
+	__u32 lag;		/* bytes queued for this file right now */
+	__u32 reserved;
+};
+
+/*
+ * ---- Read wakeups (per open file, byte stream only) ----
+ * termios VMIN/VTIME plus an end-of-line byte. A blocking read() sleeps
+ * until one of the enabled conditions holds, and the RX path checks them
+ * before waking it, so a reader wakes once per message instead of once per
+ * FIFO interrupt. time_us with min 0 bounds the whole read (0 bytes when it
+ * expires); with min > 0 it is the line silence after the last byte. With
+ * eol_on, read() returns at most up to and including the first delimiter.
+ * Framed modes and non-blocking reads ignore all of this.
+ */
+struct my_uart_wake {
+	__u32 min;		/* bytes; 0 or 1: any data (default), capped at the read size */
+	__u32 time_us;		/* 0: no timer */
+	__u8 eol;		/* delimiter byte */
+	__u8 eol_on;
+	__u8 reserved[2];
+};
+
+#define MY_UART_IOC_GET_COALESCE  _IOR(MY_UART_IOC_MAGIC, 0, struct my_uart_coalesce)
+#define MY_UART_IOC_SET_COALESCE  _IOW(MY_UART_IOC_MAGIC, 1, struct my_uart_coalesce)
+#define MY_UART_IOC_GET_IRQ_STATS _IOR(MY_UART_IOC_MAGIC, 2, struct my_uart_irq_stats)
+#define MY_UART_IOC_GET_LINE      _IOR(MY_UART_IOC_MAGIC, 3, struct my_uart_line_info)
+#define MY_UART_IOC_SET_LINE      _IOWR(MY_UART_IOC_MAGIC, 4, struct my_uart_line_info)
+#define MY_UART_IOC_GET_FRAMING   _IOR(MY_UART_IOC_MAGIC, 5, __u32)
+#define MY_UART_IOC_SET_FRAMING   _IOW(MY_UART_IOC_MAGIC, 6, __u32)
+#define MY_UART_IOC_GET_FRAME_STATS _IOR(MY_UART_IOC_MAGIC, 7, struct my_uart_frame_stats)
+/* Silence in microseconds that ends a MY_UART_FRAMING_IDLE burst; 0 = Modbus t3.5 */
+#define MY_UART_IOC_GET_IDLE_GAP  _IOR(MY_UART_IOC_MAGIC, 8, __u32)
+#define MY_UART_IOC_SET_IDLE_GAP  _IOW(MY_UART_IOC_MAGIC, 9, __u32)
+#define MY_UART_IOC_GET_RX_TS     _IOR(MY_UART_IOC_MAGIC, 10, __u32)
+#define MY_UART_IOC_SET_RX_TS     _IOW(MY_UART_IOC_MAGIC, 11, __u32)
+#define MY_UART_IOC_READ_TS       _IOWR(MY_UART_IOC_MAGIC, 12, struct my_uart_read_ts)
+#define MY_UART_IOC_READ_ERR      _IOWR(MY_UART_IOC_MAGIC, 13, struct my_uart_read_err)
+#define MY_UART_IOC_GET_MMAP_LEN  _IOR(MY_UART_IOC_MAGIC, 14, __u32)
+#define MY_UART_IOC_GET_RING      _IOR(MY_UART_IOC_MAGIC, 15, struct my_uart_ring_cfg)
+#define MY_UART_IOC_SET_RING      _IOW(MY_UART_IOC_MAGIC, 16, struct my_uart_ring_cfg)
+#define MY_UART_IOC_GET_BUSY_POLL _IOR(MY_UART_IOC_MAGIC, 17, struct my_uart_busy_poll)
+/* Budget in microseconds */
+#define MY_UART_IOC_SET_BUSY_POLL _IOW(MY_UART_IOC_MAGIC, 18, __u32)
+#define MY_UART_IOC_GET_FANOUT    _IOR(MY_UART_IOC_MAGIC, 19, __u32)
+#define MY_UART_IOC_SET_FANOUT    _IOW(MY_UART_IOC_MAGIC, 20, __u32)
+#define MY_UART_IOC_GET_FANOUT_STATS _IOR(MY_UART_IOC_MAGIC, 21, struct my_uart_fanout_stats)
+#define MY_UART_IOC_GET_WAKE      _IOR(MY_UART_IOC_MAGIC, 22, struct my_uart_wake)
+#define MY_UART_IOC_SET_WAKE      _IOW(MY_UART_IOC_MAGIC, 23, struct my_uart_wake)
+
+#endif /* MY_UART3_IOCTL_H */
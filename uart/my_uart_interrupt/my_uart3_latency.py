@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Per-byte end-to-end latency from my_uart tracepoints.
+
+Capture on the target (loopback=1, or a peer that echoes every byte):
+
+    echo 1 > /sys/kernel/tracing/events/my_uart/enable
+    echo > /sys/kernel/tracing/trace
+    ./my_uart3_app
+    cat /sys/kernel/tracing/trace > trace.txt
+
+then:
+
+    python3 my_uart3_latency.py trace.txt --line 3
+
+Byte k written by write() (my_uart_tx_put) is matched with byte k received
+(my_uart_rx_put: landed in the RX ring, my_uart_rx_get: copied to the reader).
+Three stages are reported in microseconds:
+
+    wire    tx_put -> rx_put   TX ring, FIFO, line, RX FIFO and ISR
+    wakeup  rx_put -> rx_get   wait queue, scheduler and read()
+    total   tx_put -> rx_get
+"""
+
+import argparse
+import re
+import sys
+
+LINE_RE = re.compile(r"\s(\d+\.\d+):\s+(my_uart_\w+):\s+(.*)$")
+ARG_RE = re.compile(r"(\w+)=(\S+)")
+
+
+def parse(path, line):
+    """Return {event: [(ts_us, bytes), ...]} for the ring batch events of one port."""
+    events = {"my_uart_tx_put": [], "my_uart_rx_put": [], "my_uart_rx_get": []}
+    with open(path) as f:
+        for text in f:
+            m = LINE_RE.search(text)
+            if not m or m.group(2) not in events:
+                continue
+            args = dict(ARG_RE.findall(m.group(3)))
+            if int(args.get("line", -1)) != line:
+                continue
+            n = int(args.get("bytes", 0))
+            if n:
+                events[m.group(2)].append((float(m.group(1)) * 1e6, n))
+    return events
+
+
+def per_byte(batches):
+    """Expand (ts, n) batches into one timestamp per byte, in stream order."""
+    out = []
+    for ts, n in batches:
+        out.extend([ts] * n)
+    return out
+
+
+def summary(name, deltas):
+    if not deltas:
+        print(f"{name:7s} no samples")
+        return
+    deltas.sort()
+    n = len(deltas)
+
+    def pct(p):
+        return deltas[min(n - 1, int(n * p / 100))]
+
+    print(f"{name:7s} n={n:<8d} min={deltas[0]:9.1f} p50={pct(50):9.1f} "
+          f"p90={pct(90):9.1f} p99={pct(99):9.1f} max={deltas[-1]:9.1f}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("trace", help="ftrace text output (tracefs 'trace' file)")
+    ap.add_argument("--line", type=int, default=3, help="N of /dev/my_uartN (default 3)")
+    args = ap.parse_args()
+
+    ev = parse(args.trace, args.line)
+    tx = per_byte(ev["my_uart_tx_put"])
+    rx_put = per_byte(ev["my_uart_rx_put"])
+    rx_get = per_byte(ev["my_uart_rx_get"])
+
+    if not tx or not rx_put:
+        sys.exit("no my_uart_tx_put/my_uart_rx_put events for line %d" % args.line)
+    if len(rx_put) != len(tx):
+        print(f"warning: {len(tx)} bytes written, {len(rx_put)} received; "
+              f"matching the first {min(len(tx), len(rx_put))}", file=sys.stderr)
+
+    summary("wire", [r - t for t, r in zip(tx, rx_put)])
+    summary("wakeup", [g - p for p, g in zip(rx_put, rx_get)])
+    summary("total", [g - t for t, g in zip(tx, rx_get)])
+
+
+if __name__ == "__main__":
+    main()
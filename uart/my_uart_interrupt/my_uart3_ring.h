@@ -0,0 +1,101 @@
+/* SPSC ring for my_uart3_dev.c, also built into my_uart3_ring_test.c (KUnit) */
+#ifndef MY_UART3_RING_H
+#define MY_UART3_RING_H
+
+#include <linux/atomic.h>
+#include <linux/minmax.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/uio.h>
+
+#include "my_uart3_ioctl.h"
+
+/*
+ * ---- SPSC ring buffer (kfifo-style) ----
+ * RX: the ISR produces, read() consumes. TX: write() produces, the TX kick
+ * consumes. head/tail run free and are masked on access, so the whole buffer
+ * is usable. Each side only stores its own index (with release) and loads the
+ * other (with acquire); no lock is shared between producer and consumer.
+ *
+ * The indices live in the control page that mmap() shares with userspace,
+ * which can then take the read() or write() side. They are not trusted:
+ * whatever userspace stores, avail and space stay within 0..size.
+ *
+ * MY_UART_OVERFLOW_DROP_OLDEST bends the rule for RX: a producer facing a
+ * full ring moves tail itself, so both sides update tail with cmpxchg.
+ */
+
+struct ring {
+	char *buf;		/* vmalloc_user(): mmap() exposes it, TX DMA maps it per page */
+	unsigned int size;	/* power of two; changed with user held and the side quiesced */
+	struct my_uart_mmap_ring *ix;	/* head: producer only, tail: consumer (but see above) */
+	struct mutex user;	/* serialises read() or write() callers */
+};
+
+static inline unsigned int rb_off(struct ring *r, unsigned int i) { return i & (r->size - 1); }
+
+/* Observer (tracing/stats): neither side's index is ours */
+static inline unsigned int rb_fill(struct ring *r) { return READ_ONCE(r->ix->head) - READ_ONCE(r->ix->tail); }
+
+/* Consumer side */
+static inline unsigned int rb_avail(struct ring *r)
+{
+	return min_t(unsigned int, smp_load_acquire(&r->ix->head) - READ_ONCE(r->ix->tail), r->size);
+}
+static inline bool rb_empty(struct ring *r) { return rb_avail(r) == 0; }
+static inline char rb_get(struct ring *r)
+{
+	char c = r->buf[rb_off(r, r->ix->tail)];
+
+	/* Slot is free for the producer only after we have read it */
+	smp_store_release(&r->ix->tail, r->ix->tail + 1);
+	return c;
+}
+
+/* Producer side */
+static inline unsigned int rb_space(struct ring *r)
+{
+	return r->size - min_t(unsigned int, r->ix->head - smp_load_acquire(&r->ix->tail), r->size);
+}
+static inline bool rb_full(struct ring *r) { return rb_space(r) == 0; }
+static inline void rb_put(struct ring *r, char c)
+{
+	r->buf[rb_off(r, r->ix->head)] = c;
+
+	/* Publish the byte before the index that makes it visible */
+	smp_store_release(&r->ix->head, r->ix->head + 1);
+}
+
+/* Producer side, DROP_OLDEST: discard n bytes at tail unless the consumer moved it first */
+static inline void rb_drop(struct ring *r, unsigned int n)
+{
+	unsigned int t = smp_load_acquire(&r->ix->tail);
+
+	/* On failure the consumer freed space itself, which is just as good */
+	cmpxchg(&r->ix->tail, t, t + n);
+}
+
+/*
+ * Consumer side, RX: done with n bytes from index from. False if the
+ * producer dropped them meanwhile (and may have overwritten them).
+ */
+static inline bool rb_commit(struct ring *r, unsigned int from, unsigned int n)
+{
+	return cmpxchg_release(&r->ix->tail, from, from + n) == from;
+}
+
+/* Consumer side: copy n bytes from index from, wrapping at the end of buf */
+static inline bool rb_copy_to_iter(struct ring *r, unsigned int from, unsigned int n,
+				   struct iov_iter *to)
+{
+	unsigned int off = rb_off(r, from);
+	unsigned int first = min(n, r->size - off);
+
+	return copy_to_iter(r->buf + off, first, to) == first &&
+	       copy_to_iter(r->buf, n - first, to) == n - first;
+}
+
+/* mmap() layout: control page, then each ring rounded up to whole pages */
+static inline unsigned long rb_map_len(struct ring *r) { return PAGE_ALIGN(r->size); }
+
+#endif /* MY_UART3_RING_H */
@@ -0,0 +1,211 @@
+/*
+ * KUnit tests for the SPSC ring in my_uart3_ring.h. Load with kunit.ko:
+ *   insmod my_uart3_ring_test.ko; cat /sys/kernel/debug/kunit/my_uart3_ring/results
+ */
+#include <kunit/test.h>
+#include <linux/completion.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+
+#include "my_uart3_ring.h"
+
+#define RB_TEST_SIZE	256
+#define RB_TEST_BYTES	(1U << 20)	/* 4096 trips round the ring */
+#define RB_TEST_CHUNK	97		/* odd reads, so copies split at every offset */
+#define RB_TEST_TIMEOUT_MS 10000
+
+/* Different for i and i + RB_TEST_SIZE: a lost or repeated lap shows up */
+static char rb_test_byte(unsigned int i) { return i ^ (i >> 8); }
+
+static void rb_test_init(struct kunit *test, struct ring *r, unsigned int start)
+{
+	r->size = RB_TEST_SIZE;
+	r->buf = kunit_kzalloc(test, r->size, GFP_KERNEL);
+	r->ix = kunit_kzalloc(test, sizeof(*r->ix), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, r->buf);
+	KUNIT_ASSERT_NOT_NULL(test, r->ix);
+	r->ix->head = r->ix->tail = start;
+	mutex_init(&r->user);
+}
+
+/* Consumer side as read() does it: bulk copy, then commit */
+static bool rb_test_read(struct ring *r, char *dst, unsigned int n)
+{
+	unsigned int from = READ_ONCE(r->ix->tail);
+	struct kvec kv = { .iov_base = dst, .iov_len = n };
+	struct iov_iter it;
+
+	iov_iter_kvec(&it, ITER_DEST, &kv, 1, n);
+	return rb_copy_to_iter(r, from, n, &it) && rb_commit(r, from, n);
+}
+
+/* Indices crossing UINT_MAX and a copy crossing the end of buf */
+static void rb_test_wrap(struct kunit *test)
+{
+	struct ring r;
+	char out[RB_TEST_SIZE];
+	unsigned int i;
+
+	rb_test_init(test, &r, 0U - RB_TEST_SIZE / 2 - 3);
+	for (i = 0; i < RB_TEST_SIZE; i++)
+		rb_put(&r, rb_test_byte(i));
+	KUNIT_EXPECT_TRUE(test, rb_full(&r));
+	KUNIT_EXPECT_EQ(test, rb_avail(&r), RB_TEST_SIZE);
+
+	KUNIT_ASSERT_TRUE(test, rb_test_read(&r, out, RB_TEST_SIZE));
+	for (i = 0; i < RB_TEST_SIZE; i++)
+		KUNIT_EXPECT_EQ(test, out[i], rb_test_byte(i));
+	KUNIT_EXPECT_TRUE(test, rb_empty(&r));
+	KUNIT_EXPECT_EQ(test, rb_space(&r), RB_TEST_SIZE);
+}
+
+/* Whatever userspace leaves in the shared indices, avail and space stay in range */
+static void rb_test_untrusted(struct kunit *test)
+{
+	struct ring r;
+
+	rb_test_init(test, &r, 0);
+	r.ix->head = 5 * RB_TEST_SIZE;
+	KUNIT_EXPECT_EQ(test, rb_avail(&r), RB_TEST_SIZE);
+	KUNIT_EXPECT_EQ(test, rb_space(&r), 0);
+	r.ix->tail = r.ix->head + 1;
+	KUNIT_EXPECT_EQ(test, rb_avail(&r), RB_TEST_SIZE);
+	KUNIT_EXPECT_EQ(test, rb_space(&r), 0);
+}
+
+/* DROP_OLDEST: the producer's drop and the consumer's commit race for tail */
+static void rb_test_drop(struct kunit *test)
+{
+	struct ring r;
+	unsigned int from;
+
+	rb_test_init(test, &r, 0);
+	rb_put(&r, 'a');
+	rb_put(&r, 'b');
+	from = r.ix->tail;
+	rb_drop(&r, 1);
+	KUNIT_EXPECT_FALSE(test, rb_commit(&r, from, 1));
+	KUNIT_EXPECT_EQ(test, rb_get(&r), 'b');
+	KUNIT_EXPECT_TRUE(test, rb_empty(&r));
+}
+
+struct rb_test_ctx {
+	struct ring r;
+	unsigned int got;	/* bytes the consumer checked, in order */
+	struct completion done;
+};
+
+static int rb_test_producer(void *arg)
+{
+	struct rb_test_ctx *c = arg;
+	unsigned int i;
+
+	for (i = 0; i < RB_TEST_BYTES; i++) {
+		while (rb_full(&c->r)) {
+			if (kthread_should_stop())
+				return -EINTR;
+			cond_resched();
+		}
+		rb_put(&c->r, rb_test_byte(i));
+	}
+	return 0;
+}
+
+static int rb_test_consumer(void *arg)
+{
+	struct rb_test_ctx *c = arg;
+	char chunk[RB_TEST_CHUNK];
+	unsigned int got = 0, n, i;
+	int ret = 0;
+
+	while (got < RB_TEST_BYTES) {
+		n = min3(rb_avail(&c->r), RB_TEST_BYTES - got, got % RB_TEST_CHUNK + 1);
+		if (!n) {
+			if (kthread_should_stop()) {
+				ret = -EINTR;
+				break;
+			}
+			cond_resched();
+			continue;
+		}
+		if (!rb_test_read(&c->r, chunk, n)) {
+			ret = -EIO;
+			break;
+		}
+		for (i = 0; i < n && chunk[i] == rb_test_byte(got + i); i++)
+			;
+		got += i;
+		if (i < n) {
+			ret = -EIO;
+			break;
+		}
+	}
+	c->got = got;
+	complete(&c->done);
+	return ret;
+}
+
+/* Referenced, so kthread_stop_put() still works once fn has returned */
+static struct task_struct *rb_test_thread(int (*fn)(void *), struct rb_test_ctx *c,
+					  const char *name)
+{
+	struct task_struct *t = kthread_create(fn, c, "%s", name);
+
+	if (!IS_ERR(t)) {
+		get_task_struct(t);
+		wake_up_process(t);
+	}
+	return t;
+}
+
+/* One kthread puts a byte sequence, another bulk-reads it: in order, nothing lost */
+static void rb_test_threads(struct kunit *test)
+{
+	struct rb_test_ctx *c = kunit_kzalloc(test, sizeof(*c), GFP_KERNEL);
+	struct task_struct *prod, *cons;
+	unsigned long left;
+	int pret, cret;
+
+	KUNIT_ASSERT_NOT_NULL(test, c);
+	rb_test_init(test, &c->r, 0U - 1000);
+	init_completion(&c->done);
+
+	cons = rb_test_thread(rb_test_consumer, c, "rb_test_cons");
+	KUNIT_ASSERT_FALSE(test, IS_ERR(cons));
+	prod = rb_test_thread(rb_test_producer, c, "rb_test_prod");
+	if (IS_ERR(prod)) {
+		kthread_stop_put(cons);
+		KUNIT_FAIL(test, "producer: %ld", PTR_ERR(prod));
+		return;
+	}
+
+	left = wait_for_completion_timeout(&c->done, msecs_to_jiffies(RB_TEST_TIMEOUT_MS));
+	pret = kthread_stop_put(prod);
+	cret = kthread_stop_put(cons);
+
+	KUNIT_EXPECT_NE_MSG(test, left, 0, "consumer stuck at byte %u", c->got);
+	KUNIT_EXPECT_EQ(test, pret, 0);
+	KUNIT_EXPECT_EQ_MSG(test, cret, 0, "byte %u out of order or lost", c->got);
+	KUNIT_EXPECT_EQ(test, c->got, RB_TEST_BYTES);
+	KUNIT_EXPECT_TRUE(test, rb_empty(&c->r));
+}
+
+static struct kunit_case my_uart3_ring_cases[] = {
+	KUNIT_CASE(rb_test_wrap),
+	KUNIT_CASE(rb_test_untrusted),
+	KUNIT_CASE(rb_test_drop),
+	KUNIT_CASE_SLOW(rb_test_threads),
+	{}
+};
+
+static struct kunit_suite my_uart3_ring_suite = {
+	.name = "my_uart3_ring",
+	.test_cases = my_uart3_ring_cases,
+};
+kunit_test_suite(my_uart3_ring_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("jeong7231");
+MODULE_DESCRIPTION("KUnit tests for the my_uart3 SPSC ring");
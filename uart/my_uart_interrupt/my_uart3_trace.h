@@ -0,0 +1,124 @@
+/* Static tracepoints for my_uart3_dev.c (events:my_uart/ in tracefs) */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM my_uart
+
+#if !defined(_MY_UART3_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MY_UART3_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* ---- ISR ---- */
+TRACE_EVENT(my_uart_isr_entry,
+	TP_PROTO(unsigned int line, u32 mis),
+	TP_ARGS(line, mis),
+	TP_STRUCT__entry(
+		__field(unsigned int, line)
+		__field(u32, mis)
+	),
+	TP_fast_assign(
+		__entry->line = line;
+		__entry->mis = mis;
+	),
+	TP_printk("line=%u mis=0x%03x", __entry->line, __entry->mis)
+);
+
+TRACE_EVENT(my_uart_isr_exit,
+	TP_PROTO(unsigned int line, u32 mis, unsigned int rx, unsigned int tx,
+		 unsigned int rx_fill),
+	TP_ARGS(line, mis, rx, tx, rx_fill),
+	TP_STRUCT__entry(
+		__field(unsigned int, line)
+		__field(u32, mis)
+		__field(unsigned int, rx)
+		__field(unsigned int, tx)
+		__field(unsigned int, rx_fill)
+	),
+	TP_fast_assign(
+		__entry->line = line;
+		__entry->mis = mis;
+		__entry->rx = rx;
+		__entry->tx = tx;
+		__entry->rx_fill = rx_fill;
+	),
+	TP_printk("line=%u mis=0x%03x rx=%u tx=%u rx_fill=%u",
+		  __entry->line, __entry->mis, __entry->rx, __entry->tx,
+		  __entry->rx_fill)
+);
+
+/* ---- Ring batches: bytes moved by one producer/consumer pass, fill after it ---- */
+DECLARE_EVENT_CLASS(my_uart_ring,
+	TP_PROTO(unsigned int line, unsigned int bytes, unsigned int fill),
+	TP_ARGS(line, bytes, fill),
+	TP_STRUCT__entry(
+		__field(unsigned int, line)
+		__field(unsigned int, bytes)
+		__field(unsigned int, fill)
+	),
+	TP_fast_assign(
+		__entry->line = line;
+		__entry->bytes = bytes;
+		__entry->fill = fill;
+	),
+	TP_printk("line=%u bytes=%u fill=%u",
+		  __entry->line, __entry->bytes, __entry->fill)
+);
+
+DEFINE_EVENT(my_uart_ring, my_uart_rx_put,
+	TP_PROTO(unsigned int line, unsigned int bytes, unsigned int fill),
+	TP_ARGS(line, bytes, fill));
+DEFINE_EVENT(my_uart_ring, my_uart_rx_get,
+	TP_PROTO(unsigned int line, unsigned int bytes, unsigned int fill),
+	TP_ARGS(line, bytes, fill));
+DEFINE_EVENT(my_uart_ring, my_uart_tx_put,
+	TP_PROTO(unsigned int line, unsigned int bytes, unsigned int fill),
+	TP_ARGS(line, bytes, fill));
+/* TX kick: bytes handed to the FIFO (PIO) or queued to the DMA engine */
+DEFINE_EVENT(my_uart_ring, my_uart_tx_kick,
+	TP_PROTO(unsigned int line, unsigned int bytes, unsigned int fill),
+	TP_ARGS(line, bytes, fill));
+
+/* ---- File operations ---- */
+TRACE_EVENT(my_uart_open,
+	TP_PROTO(unsigned int line),
+	TP_ARGS(line),
+	TP_STRUCT__entry(
+		__field(unsigned int, line)
+	),
+	TP_fast_assign(
+		__entry->line = line;
+	),
+	TP_printk("line=%u", __entry->line)
+);
+
+DECLARE_EVENT_CLASS(my_uart_io,
+	TP_PROTO(unsigned int line, size_t count, ssize_t ret),
+	TP_ARGS(line, count, ret),
+	TP_STRUCT__entry(
+		__field(unsigned int, line)
+		__field(size_t, count)
+		__field(ssize_t, ret)
+	),
+	TP_fast_assign(
+		__entry->line = line;
+		__entry->count = count;
+		__entry->ret = ret;
+	),
+	TP_printk("line=%u count=%zu ret=%zd",
+		  __entry->line, __entry->count, __entry->ret)
+);
+
+DEFINE_EVENT(my_uart_io, my_uart_read,
+	TP_PROTO(unsigned int line, size_t count, ssize_t ret),
+	TP_ARGS(line, count, ret));
+DEFINE_EVENT(my_uart_io, my_uart_write,
+	TP_PROTO(unsigned int line, size_t count, ssize_t ret),
+	TP_ARGS(line, count, ret));
+
+#endif /* _MY_UART3_TRACE_H */
+
+/* Kbuild adds -I$(src) for this (see Makefile) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE my_uart3_trace
+#include <trace/define_trace.h>
@@ -4,6 +4,12 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #define DEVICE_NAME "my_uart3"
 #define UART3_BASE_PHYS 0xFE201600 // BCM2711 PL011 UART3 base address, bus address : 0x7e201600
@@ -33,9 +39,107 @@ unsigned int fbrd = CALC_FBRD(BAUDRATE);
 #define UART_FR_TXFF (1 << 5) // Transmit FIFO Full
 #define UART_FR_RXFE (1 << 4) // Receive FIFO Empty
 
-// UART3 초기화
+// hrtimer 폴링: IRQ 없이 주기적으로 RX FIFO -> rxrb, txrb -> TX FIFO
+#define UART_FIFO_DEPTH 32  // PL011 FIFO 깊이 (byte)
+#define UART_CHAR_BITS 10   // 8N1: start + 8 data + stop
+#define POLL_MIN_NS 100000  // 주기 하한 100us, CPU 사용량 상한
+
+// FIFO 절반이 차는 시간: 115200bps에서 약 1.39ms
+// 타이머가 한 주기 늦어도 나머지 절반이 RX 오버런을 막고 TX 라인도 쉬지 않음
+static u64 poll_period_ns;
+
+#define RB_SZ 4096 // 2의 거듭제곱
+struct ring {
+    char buf[RB_SZ];
+    unsigned int head; // producer만 갱신
+    unsigned int tail; // consumer만 갱신
+};
+
+// rxrb: 타이머가 채우고 read()가 비움, txrb: write()가 채우고 타이머/write()가 비움
+static struct ring rxrb, txrb;
+static DEFINE_SPINLOCK(tx_lock); // txrb consumer (타이머, write()의 즉시 전송)
+static DEFINE_MUTEX(rx_user);    // read() 호출자끼리 직렬화
+static DEFINE_MUTEX(tx_user);    // write() 호출자끼리 직렬화
+static DECLARE_WAIT_QUEUE_HEAD(rx_wq);
+static DECLARE_WAIT_QUEUE_HEAD(tx_wq);
+
+static struct hrtimer poll_timer;
+static DEFINE_MUTEX(open_lock);
+static int open_count;
+static unsigned long rx_stalls; // rxrb가 가득 차서 FIFO에 남겨 둔 횟수
+
+#define TX_DRAIN_MS 2000 // 마지막 close에서 txrb를 비우며 기다리는 최대 시간
+
+static inline unsigned int rb_avail(struct ring *r)
+{
+    return smp_load_acquire(&r->head) - r->tail;
+}
+
+static inline unsigned int rb_space(struct ring *r)
+{
+    return RB_SZ - (r->head - smp_load_acquire(&r->tail));
+}
+
+// txrb -> TX FIFO, tx_lock 안에서 호출
+static unsigned int my_uart3_tx_fill(void)
+{
+    unsigned int t = txrb.tail;
+    unsigned int h = smp_load_acquire(&txrb.head);
+    unsigned int sent = 0;
+
+    while (t != h && !(readl(uart3_base + UART_FR) & UART_FR_TXFF))
+    {
+        writel(txrb.buf[t++ & (RB_SZ - 1)], uart3_base + UART_DR);
+        sent++;
+    }
+    smp_store_release(&txrb.tail, t);
+    return sent;
+}
+
+static enum hrtimer_restart my_uart3_poll_timer(struct hrtimer *timer)
+{
+    unsigned int h = rxrb.head;
+    unsigned int rx = 0, tx;
+
+    // RX FIFO -> rxrb
+    // rxrb가 가득 차면 FIFO에 남겨 둠 (버리지 않음), read()가 비우면 다음 주기에 가져감
+    while (!(readl(uart3_base + UART_FR) & UART_FR_RXFE))
+    {
+        if (h - smp_load_acquire(&rxrb.tail) == RB_SZ)
+        {
+            rx_stalls++;
+            break;
+        }
+        rxrb.buf[h++ & (RB_SZ - 1)] = readl(uart3_base + UART_DR) & 0xFF;
+        rx++;
+    }
+    if (rx)
+    {
+        smp_store_release(&rxrb.head, h);
+        wake_up_interruptible(&rx_wq);
+    }
+
+    // txrb -> TX FIFO
+    spin_lock(&tx_lock);
+    tx = my_uart3_tx_fill();
+    spin_unlock(&tx_lock);
+    if (tx)
+        wake_up_interruptible(&tx_wq);
+
+    hrtimer_forward_now(timer, ns_to_ktime(poll_period_ns));
+    return HRTIMER_RESTART;
+}
+
+// UART3 초기화, 첫 open에서만 하드웨어 설정 후 폴링 타이머 시작
 static int my_uart3_open(struct inode *inode, struct file *file)
 {
+    mutex_lock(&open_lock);
+    if (open_count++)
+    {
+        mutex_unlock(&open_lock);
+        return 0;
+    }
+
     // 1. UART Disable
     writel(0x0, uart3_base + UART_CR);
 
@@ -55,63 +159,137 @@ static int my_uart3_open(struct inode *inode, struct file *file)
     // 5. UART enable, TX/RX enable
     writel((1 << 0) | (1 << 8) | (1 << 9), uart3_base + UART_CR);
 
-    pr_info("my_uart3: UART3 opened/initialized\n");
+    // 6. 링 비우고 폴링 시작
+    rxrb.head = rxrb.tail = 0;
+    txrb.head = txrb.tail = 0;
+    hrtimer_start(&poll_timer, ns_to_ktime(poll_period_ns), HRTIMER_MODE_REL);
+    mutex_unlock(&open_lock);
+
+    pr_info("my_uart3: UART3 opened/initialized (poll %llu ns)\n", poll_period_ns);
     return 0;
 }
 
-static ssize_t my_uart3_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+// 마지막 close: 남은 TX를 보낸 뒤 타이머 정지
+static int my_uart3_release(struct inode *inode, struct file *file)
 {
-    size_t i;
-    char ch;
-
-    for (i = 0; i < count; i++)
+    mutex_lock(&open_lock);
+    if (--open_count == 0)
     {
-        if (copy_from_user(&ch, buf + i, 1))
-            return -EFAULT;
+        wait_event_timeout(tx_wq, !rb_avail(&txrb), msecs_to_jiffies(TX_DRAIN_MS));
+        hrtimer_cancel(&poll_timer);
+        if (rx_stalls)
+            pr_info("my_uart3: rx ring full %lu times\n", rx_stalls);
+    }
+    mutex_unlock(&open_lock);
+    return 0;
+}
+
+// 전부 txrb에 넣을 때까지 (O_NONBLOCK이면 들어간 만큼만), 실제 전송은 타이머가 이어감
+static ssize_t my_uart3_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    unsigned int n, off, first;
+    unsigned long flags;
+    size_t done = 0;
+    int ret = 0;
 
-        // TX FIFO Full이면 대기
-        while (readl(uart3_base + UART_FR) & UART_FR_TXFF)
-            cpu_relax();
+    if (mutex_lock_interruptible(&tx_user))
+        return -ERESTARTSYS;
 
-        writel(ch, uart3_base + UART_DR);
+    while (done < count)
+    {
+        n = min_t(size_t, rb_space(&txrb), count - done);
+        if (!n)
+        {
+            // txrb 가득 참: 타이머가 FIFO로 옮겨 자리가 날 때까지 잠듦 (busy-wait 없음)
+            if (file->f_flags & O_NONBLOCK)
+            {
+                if (!done)
+                    ret = -EAGAIN;
+                break;
+            }
+            ret = wait_event_interruptible(tx_wq, rb_space(&txrb));
+            if (ret)
+                break;
+            continue;
+        }
+
+        off = txrb.head & (RB_SZ - 1);
+        first = min_t(unsigned int, n, RB_SZ - off);
+        if (copy_from_user(txrb.buf + off, buf + done, first) ||
+            copy_from_user(txrb.buf, buf + done + first, n - first))
+        {
+            ret = -EFAULT;
+            break;
+        }
+        smp_store_release(&txrb.head, txrb.head + n);
+        done += n;
+
+        // FIFO에 자리가 있으면 다음 주기까지 기다리지 않고 바로 전송
+        spin_lock_irqsave(&tx_lock, flags);
+        my_uart3_tx_fill();
+        spin_unlock_irqrestore(&tx_lock, flags);
     }
-    return count;
+
+    mutex_unlock(&tx_user);
+    return done ? done : ret;
 }
 
+// rxrb에 쌓인 만큼 복사, 없으면 0 (기존 논블로킹 동작 유지, 기다리려면 poll())
 static ssize_t my_uart3_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
 {
-    char kbuf[128];
-    size_t i;
+    unsigned int n, off, first;
+    ssize_t ret;
 
-    if (count > sizeof(kbuf))
-        count = sizeof(kbuf);
+    if (mutex_lock_interruptible(&rx_user))
+        return -ERESTARTSYS;
 
-    for (i = 0; i < count; i++)
+    n = min_t(size_t, rb_avail(&rxrb), count);
+    off = rxrb.tail & (RB_SZ - 1);
+    first = min_t(unsigned int, n, RB_SZ - off);
+    if (copy_to_user(buf, rxrb.buf + off, first) ||
+        copy_to_user(buf + first, rxrb.buf, n - first))
     {
-        // RX FIFO Empty면 즉시 break (논블로킹)
-        if (readl(uart3_base + UART_FR) & UART_FR_RXFE)
-            break;
-        kbuf[i] = readl(uart3_base + UART_DR) & 0xFF;
+        ret = -EFAULT;
+        goto out;
     }
+    smp_store_release(&rxrb.tail, rxrb.tail + n);
+    ret = n;
+out:
+    mutex_unlock(&rx_user);
+    return ret;
+}
 
-    if (i == 0)
-        return 0;
+static __poll_t my_uart3_poll(struct file *file, poll_table *wait)
+{
+    __poll_t mask = 0;
 
-    if (copy_to_user(buf, kbuf, i))
-        return -EFAULT;
+    poll_wait(file, &rx_wq, wait);
+    poll_wait(file, &tx_wq, wait);
 
-    return i;
+    if (rb_avail(&rxrb))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (rb_space(&txrb))
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    return mask;
 }
 
 static struct file_operations my_uart3_fops = {
     .owner = THIS_MODULE,
     .open = my_uart3_open,
+    .release = my_uart3_release,
     .read = my_uart3_read,
     .write = my_uart3_write,
+    .poll = my_uart3_poll,
 };
 
 static int __init my_uart3_init(void)
 {
+    poll_period_ns = div_u64((u64)UART_FIFO_DEPTH / 2 * UART_CHAR_BITS * NSEC_PER_SEC, BAUDRATE);
+    if (poll_period_ns < POLL_MIN_NS)
+        poll_period_ns = POLL_MIN_NS;
+    hrtimer_init(&poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    poll_timer.function = my_uart3_poll_timer;
+
     major = register_chrdev(0, DEVICE_NAME, &my_uart3_fops);
     if (major < 0)
     {
@@ -133,6 +311,8 @@ static int __init my_uart3_init(void)
 
 static void __exit my_uart3_exit(void)
 {
+    hrtimer_cancel(&poll_timer);
+
     if (uart3_base)
         iounmap(uart3_base);
 
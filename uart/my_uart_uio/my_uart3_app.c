@@ -0,0 +1,133 @@
+// Round-trip latency: one byte out, wait for it to come back in loopback.
+//   ./my_uart3_app uio [count]   my_uart3_dev.ko (UIO) + busy-poll thread
+//   ./my_uart3_app dev [count]   ../my_uart_interrupt driver, loaded with loopback=1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+#include "my_uart3_uio.h"
+
+#define DEVICE "/dev/my_uart3"
+#define UIO_NAME "my_uart3"
+#define BAUD 115200
+#define POLL_CPU 3 // isolcpus=3 on the target
+
+static struct my_uart_uio uio; // two rings: too big for the stack
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int rtt_uio(long long *rtt, int count)
+{
+    struct my_uart_uio_cfg cfg = {
+        .name = UIO_NAME, .baud = BAUD, .cpu = POLL_CPU, .prio = 50, .loopback = 1,
+    };
+    int ret = my_uart_uio_open(&uio, &cfg);
+
+    if (ret) {
+        fprintf(stderr, "my_uart_uio_open: %s\n", strerror(-ret));
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        unsigned char tx = i & 0xFF, rx;
+        long long t0 = now_ns(), deadline = t0 + 1000000000LL;
+
+        my_uart_uio_write(&uio, &tx, 1);
+        while (!my_uart_uio_read(&uio, &rx, 1)) {
+            if (now_ns() > deadline) {
+                fprintf(stderr, "round trip %d: timeout\n", i);
+                my_uart_uio_close(&uio);
+                return 1;
+            }
+        }
+        rtt[i] = now_ns() - t0;
+        if (rx != tx)
+            fprintf(stderr, "round trip %d: sent 0x%02x got 0x%02x\n", i, tx, rx);
+    }
+
+    printf("poll loops %llu, overruns %llu, rx dropped %llu\n",
+           (unsigned long long)uio.stats.loops,
+           (unsigned long long)uio.stats.overruns,
+           (unsigned long long)uio.stats.rx_dropped);
+    my_uart_uio_close(&uio);
+    return 0;
+}
+
+static int rtt_dev(long long *rtt, int count)
+{
+    int fd = open(DEVICE, O_RDWR);
+
+    if (fd < 0) {
+        perror("Failed to open device");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        unsigned char tx = i & 0xFF, rx;
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        long long t0 = now_ns();
+
+        if (write(fd, &tx, 1) != 1) {
+            perror("Write failed");
+            close(fd);
+            return 1;
+        }
+        if (poll(&pfd, 1, 1000) <= 0 || read(fd, &rx, 1) != 1) {
+            fprintf(stderr, "round trip %d: timeout\n", i);
+            close(fd);
+            return 1;
+        }
+        rtt[i] = now_ns() - t0;
+        if (rx != tx)
+            fprintf(stderr, "round trip %d: sent 0x%02x got 0x%02x\n", i, tx, rx);
+    }
+
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 2 ? atoi(argv[2]) : 10000;
+    long long *rtt;
+    int ret;
+
+    if (argc < 2 || count <= 0 || (strcmp(argv[1], "uio") && strcmp(argv[1], "dev"))) {
+        fprintf(stderr, "usage: %s uio|dev [count]\n", argv[0]);
+        return 1;
+    }
+
+    rtt = calloc(count, sizeof(*rtt));
+    if (!rtt)
+        return 1;
+
+    ret = !strcmp(argv[1], "uio") ? rtt_uio(rtt, count) : rtt_dev(rtt, count);
+    if (!ret) {
+        // one character at 115200 8N1 is ~87 us of wire time; the rest is software
+        qsort(rtt, count, sizeof(*rtt), cmp_ll);
+        printf("%s: %d round trips, us min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+               argv[1], count, rtt[0] / 1e3, rtt[count / 2] / 1e3,
+               rtt[count * 9 / 10] / 1e3, rtt[count * 99 / 100] / 1e3,
+               rtt[count - 1] / 1e3);
+    }
+
+    free(rtt);
+    return ret;
+}
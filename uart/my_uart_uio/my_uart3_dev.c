@@ -0,0 +1,166 @@
+#include <linux/init.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/uio_driver.h>
+
+/*
+ * UIO variant of ../my_uart_interrupt/my_uart3_dev.c: binds the same DT
+ * nodes (load one or the other) and hands the PL011 to userspace.
+ *
+ *   map0: the register window, uncached. The 4 KiB page also holds the
+ *         neighbouring PL011s; the UART sits at maps/map0/offset in it.
+ *   irq:  the uio_pdrv_genirq protocol. read() the 32-bit event count,
+ *         write() 1 to re-arm, 0 to hold off.
+ *
+ * The BCM2711 PL011s share one GIC line, so instead of disabling the line
+ * like uio_pdrv_genirq the handler masks this UART's IMSC, and re-arming
+ * restores it. A busy-polling user (see my_uart3_uio.c) just leaves IMSC
+ * at zero and never touches the fd beyond mmap().
+ */
+#define DEVICE_NAME "my_uart"
+#define UART3_REG_SIZE 0x90
+
+#define MY_UART_PORT_STRIDE 0x200
+#define MY_UART_LINE(start) (((start) & 0xfff) / MY_UART_PORT_STRIDE)
+
+/* ---- PL011 offsets ---- */
+#define UART_IMSC  0x38
+#define UART_MIS   0x40
+#define UART_ICR   0x44
+
+struct my_uart_uio {
+	struct uio_info info;
+	void __iomem *base;
+	char name[16];
+	spinlock_t lock;	/* IMSC against the handler */
+	u32 imsc;		/* userspace's IMSC while the handler holds it at zero */
+	bool masked;
+};
+
+static irqreturn_t my_uart_uio_handler(int irq, struct uio_info *info)
+{
+	struct my_uart_uio *u = info->priv;
+
+	/* Shared line: not ours */
+	if (!readl(u->base + UART_MIS))
+		return IRQ_NONE;
+
+	spin_lock(&u->lock);
+	if (!u->masked) {
+		u->imsc = readl(u->base + UART_IMSC);
+		writel(0x0, u->base + UART_IMSC);
+		u->masked = true;
+	}
+	spin_unlock(&u->lock);
+	return IRQ_HANDLED;	/* uio core counts the event and wakes read() */
+}
+
+static int my_uart_uio_irqcontrol(struct uio_info *info, s32 on)
+{
+	struct my_uart_uio *u = info->priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&u->lock, flags);
+	if (on && u->masked) {
+		writel(u->imsc, u->base + UART_IMSC);
+		u->masked = false;
+	} else if (!on && !u->masked) {
+		u->imsc = readl(u->base + UART_IMSC);
+		writel(0x0, u->base + UART_IMSC);
+		u->masked = true;
+	}
+	spin_unlock_irqrestore(&u->lock, flags);
+	return 0;
+}
+
+/* Whatever the last user left enabled must not keep firing */
+static int my_uart_uio_release(struct uio_info *info, struct inode *inode)
+{
+	struct my_uart_uio *u = info->priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&u->lock, flags);
+	writel(0x0, u->base + UART_IMSC);
+	writel(0x7FF, u->base + UART_ICR);
+	u->masked = false;
+	spin_unlock_irqrestore(&u->lock, flags);
+	return 0;
+}
+
+static int my_uart_uio_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct my_uart_uio *u;
+	struct resource *res;
+	struct uio_mem *mem;
+	int irq;
+
+	u = devm_kzalloc(dev, sizeof(*u), GFP_KERNEL);
+	if (!u)
+		return -ENOMEM;
+
+	u->base = devm_platform_get_and_ioremap_resource(pdev, 0, &res);
+	if (IS_ERR(u->base))
+		return PTR_ERR(u->base);
+	if (resource_size(res) < UART3_REG_SIZE)
+		return dev_err_probe(dev, -EINVAL, "register window %pR too small\n", res);
+
+	irq = platform_get_irq(pdev, 0);
+	if (irq < 0)
+		return irq;
+
+	spin_lock_init(&u->lock);
+	snprintf(u->name, sizeof(u->name), DEVICE_NAME "%u",
+		 (unsigned int)MY_UART_LINE(res->start));
+
+	/* Quiet until userspace arms something */
+	writel(0x0, u->base + UART_IMSC);
+	writel(0x7FF, u->base + UART_ICR);
+
+	/* UIO maps whole pages: the page, and where the UART is in it */
+	mem = &u->info.mem[0];
+	mem->name = "pl011";
+	mem->memtype = UIO_MEM_PHYS;
+	mem->addr = res->start & PAGE_MASK;
+	mem->offs = res->start & ~PAGE_MASK;
+	mem->size = PAGE_ALIGN(mem->offs + UART3_REG_SIZE);
+	mem->internal_addr = u->base;
+
+	u->info.name = u->name;
+	u->info.version = "1";
+	u->info.irq = irq;
+	u->info.irq_flags = IRQF_SHARED;
+	u->info.handler = my_uart_uio_handler;
+	u->info.irqcontrol = my_uart_uio_irqcontrol;
+	u->info.release = my_uart_uio_release;
+	u->info.priv = u;
+
+	platform_set_drvdata(pdev, u);
+	dev_info(dev, "%s: uio (irq %d, base %pa)\n", u->name, irq, &res->start);
+	return devm_uio_register_device(dev, &u->info);
+}
+
+static const struct of_device_id my_uart_uio_of_match[] = {
+	{ .compatible = "jeong,my-uart" },
+	{ .compatible = "jeong,my-uart3" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, my_uart_uio_of_match);
+
+static struct platform_driver my_uart_uio_driver = {
+	.probe  = my_uart_uio_probe,
+	.driver = {
+		.name = "my_uart_uio",
+		.of_match_table = my_uart_uio_of_match,
+	},
+};
+module_platform_driver(my_uart_uio_driver);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("jeong7231");
+MODULE_DESCRIPTION("UIO PL011 UART driver for BCM2711 (Raspberry Pi 4), userspace poll mode");
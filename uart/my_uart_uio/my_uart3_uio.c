@@ -0,0 +1,257 @@
+// Userspace side of my_uart3_dev.ko (UIO), see my_uart3_uio.h
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "my_uart3_uio.h"
+
+#define UARTCLK_DEFAULT 48000000 // rpi4 default setting
+
+// PL011 UART registers offset
+#define UART_DR 0x00
+#define UART_FR 0x18
+#define UART_IBRD 0x24
+#define UART_FBRD 0x28
+#define UART_LCRH 0x2C
+#define UART_CR 0x30
+#define UART_IMSC 0x38
+#define UART_ICR 0x44
+
+#define UART_FR_TXFF (1 << 5)
+#define UART_FR_RXFE (1 << 4)
+#define UART_DR_OE (1 << 11)
+#define UART_LCRH_FEN (1 << 4)
+#define UART_LCRH_WLEN8 (3 << 5)
+#define UART_CR_UARTEN (1 << 0)
+#define UART_CR_LBE (1 << 7)
+#define UART_CR_TXE (1 << 8)
+#define UART_CR_RXE (1 << 9)
+
+#define REG(u, off) ((u)->regs[(off) / 4])
+
+static int read_sysfs_ul(const char *path, unsigned long *val)
+{
+    char buf[32];
+    FILE *f = fopen(path, "r");
+
+    if (!f)
+        return -errno;
+    if (!fgets(buf, sizeof(buf), f)) {
+        fclose(f);
+        return -EIO;
+    }
+    fclose(f);
+    *val = strtoul(buf, NULL, 0);
+    return 0;
+}
+
+// /sys/class/uio/uioN/name == name -> N
+static int find_uio(const char *name)
+{
+    char path[300], buf[32];
+    struct dirent *de;
+    DIR *d = opendir("/sys/class/uio");
+    int n = -ENODEV;
+
+    if (!d)
+        return -errno;
+    while ((de = readdir(d))) {
+        FILE *f;
+
+        if (strncmp(de->d_name, "uio", 3))
+            continue;
+        snprintf(path, sizeof(path), "/sys/class/uio/%s/name", de->d_name);
+        f = fopen(path, "r");
+        if (!f)
+            continue;
+        if (fgets(buf, sizeof(buf), f)) {
+            buf[strcspn(buf, "\n")] = '\0';
+            if (!strcmp(buf, name))
+                n = atoi(de->d_name + 3);
+        }
+        fclose(f);
+        if (n >= 0)
+            break;
+    }
+    closedir(d);
+    return n;
+}
+
+static void setup_line(struct my_uart_uio *u, const struct my_uart_uio_cfg *cfg)
+{
+    unsigned int clk = cfg->uartclk ? cfg->uartclk : UARTCLK_DEFAULT;
+    unsigned int ibrd = clk / (16 * cfg->baud);
+    unsigned int fbrd = ((clk % (16 * cfg->baud)) * 64 + cfg->baud / 2) / cfg->baud;
+
+    // Same order as the kernel drivers' open(): disable, clear, baud, LCRH, enable
+    REG(u, UART_CR) = 0;
+    REG(u, UART_IMSC) = 0; // busy-poll: no interrupts at all
+    REG(u, UART_ICR) = 0x7FF;
+    REG(u, UART_IBRD) = ibrd;
+    REG(u, UART_FBRD) = fbrd;
+    REG(u, UART_LCRH) = UART_LCRH_FEN | UART_LCRH_WLEN8;
+    REG(u, UART_CR) = UART_CR_UARTEN | UART_CR_TXE | UART_CR_RXE |
+                      (cfg->loopback ? UART_CR_LBE : 0);
+}
+
+static void *poll_thread(void *arg)
+{
+    struct my_uart_uio *u = arg;
+    unsigned int rh = atomic_load_explicit(&u->rx.head, memory_order_relaxed);
+    unsigned int tt = atomic_load_explicit(&u->tx.tail, memory_order_relaxed);
+
+    while (!atomic_load_explicit(&u->stop, memory_order_relaxed)) {
+        unsigned int rt = atomic_load_explicit(&u->rx.tail, memory_order_acquire);
+        unsigned int th = atomic_load_explicit(&u->tx.head, memory_order_acquire);
+        unsigned int rh0 = rh, tt0 = tt;
+
+        // RX FIFO -> rx ring
+        while (!(REG(u, UART_FR) & UART_FR_RXFE)) {
+            uint32_t dr = REG(u, UART_DR);
+
+            if (dr & UART_DR_OE)
+                u->stats.overruns++;
+            if (rh - rt == MY_UART_UIO_RING_SZ) {
+                u->stats.rx_dropped++;
+                continue;
+            }
+            u->rx.buf[rh++ & (MY_UART_UIO_RING_SZ - 1)] = dr & 0xFF;
+        }
+        if (rh != rh0) {
+            atomic_store_explicit(&u->rx.head, rh, memory_order_release);
+            u->stats.rx_bytes += rh - rh0;
+        }
+
+        // tx ring -> TX FIFO
+        while (tt != th && !(REG(u, UART_FR) & UART_FR_TXFF))
+            REG(u, UART_DR) = u->tx.buf[tt++ & (MY_UART_UIO_RING_SZ - 1)];
+        if (tt != tt0) {
+            atomic_store_explicit(&u->tx.tail, tt, memory_order_release);
+            u->stats.tx_bytes += tt - tt0;
+        }
+
+        u->stats.loops++;
+    }
+    return NULL;
+}
+
+static int start_thread(struct my_uart_uio *u, const struct my_uart_uio_cfg *cfg)
+{
+    pthread_attr_t attr;
+    int ret;
+
+    pthread_attr_init(&attr);
+    if (cfg->cpu >= 0) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(cfg->cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    if (cfg->prio > 0) {
+        struct sched_param sp = { .sched_priority = cfg->prio };
+
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &sp);
+    }
+    ret = pthread_create(&u->thread, &attr, poll_thread, u);
+    pthread_attr_destroy(&attr);
+    return -ret;
+}
+
+int my_uart_uio_open(struct my_uart_uio *u, const struct my_uart_uio_cfg *cfg)
+{
+    unsigned long size, offs;
+    char path[64];
+    int n, ret;
+
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+    if (!cfg->baud)
+        return -EINVAL;
+
+    n = find_uio(cfg->name);
+    if (n < 0)
+        return n;
+
+    snprintf(path, sizeof(path), "/sys/class/uio/uio%d/maps/map0/size", n);
+    ret = read_sysfs_ul(path, &size);
+    if (ret)
+        return ret;
+    snprintf(path, sizeof(path), "/sys/class/uio/uio%d/maps/map0/offset", n);
+    ret = read_sysfs_ul(path, &offs);
+    if (ret)
+        return ret;
+
+    snprintf(path, sizeof(path), "/dev/uio%d", n);
+    u->fd = open(path, O_RDWR | O_SYNC);
+    if (u->fd < 0)
+        return -errno;
+
+    // map N lives at offset N pages
+    u->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, u->fd, 0);
+    if (u->map == MAP_FAILED) {
+        ret = -errno;
+        close(u->fd);
+        u->fd = -1;
+        return ret;
+    }
+    u->map_len = size;
+    u->regs = (volatile uint32_t *)((char *)u->map + offs);
+
+    setup_line(u, cfg);
+
+    ret = start_thread(u, cfg);
+    if (ret) {
+        munmap(u->map, u->map_len);
+        close(u->fd);
+        u->fd = -1;
+    }
+    return ret;
+}
+
+void my_uart_uio_close(struct my_uart_uio *u)
+{
+    if (u->fd < 0)
+        return;
+    atomic_store(&u->stop, true);
+    pthread_join(u->thread, NULL);
+    REG(u, UART_CR) = 0;
+    munmap(u->map, u->map_len);
+    close(u->fd); // the module masks and clears the interrupts on release
+    u->fd = -1;
+}
+
+size_t my_uart_uio_read(struct my_uart_uio *u, void *buf, size_t len)
+{
+    unsigned int t = atomic_load_explicit(&u->rx.tail, memory_order_relaxed);
+    unsigned int h = atomic_load_explicit(&u->rx.head, memory_order_acquire);
+    unsigned char *p = buf;
+    size_t n = 0;
+
+    while (n < len && t != h)
+        p[n++] = u->rx.buf[t++ & (MY_UART_UIO_RING_SZ - 1)];
+    atomic_store_explicit(&u->rx.tail, t, memory_order_release);
+    return n;
+}
+
+size_t my_uart_uio_write(struct my_uart_uio *u, const void *buf, size_t len)
+{
+    unsigned int h = atomic_load_explicit(&u->tx.head, memory_order_relaxed);
+    unsigned int t = atomic_load_explicit(&u->tx.tail, memory_order_acquire);
+    const unsigned char *p = buf;
+    size_t n = 0;
+
+    while (n < len && h - t < MY_UART_UIO_RING_SZ)
+        u->tx.buf[h++ & (MY_UART_UIO_RING_SZ - 1)] = p[n++];
+    atomic_store_explicit(&u->tx.head, h, memory_order_release);
+    return n;
+}
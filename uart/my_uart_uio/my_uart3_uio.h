@@ -0,0 +1,64 @@
+/*
+ * Userspace PL011 driver on top of my_uart3_dev.ko (UIO): one pinned
+ * thread busy-polls the FIFOs and moves bytes through two SPSC rings, so
+ * the application reads and writes without a single syscall.
+ */
+#ifndef MY_UART3_UIO_H
+#define MY_UART3_UIO_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MY_UART_UIO_RING_SZ 4096 // 2의 거듭제곱
+
+// head/tail on their own cache lines: the two sides never share one
+struct my_uart_uio_ring {
+    _Atomic unsigned int head; // producer
+    char pad0[64 - sizeof(unsigned int)];
+    _Atomic unsigned int tail; // consumer
+    char pad1[64 - sizeof(unsigned int)];
+    unsigned char buf[MY_UART_UIO_RING_SZ];
+};
+
+struct my_uart_uio_cfg {
+    const char *name;      // UIO name, e.g. "my_uart3"
+    unsigned int baud;     // 8N1
+    unsigned int uartclk;  // Hz, 0: rpi4 default 48 MHz
+    int cpu;               // pin the poll thread here, -1: don't pin
+    int prio;              // SCHED_FIFO priority, 0: keep SCHED_OTHER
+    int loopback;          // PL011 internal loopback (LBE)
+};
+
+// Written by the poll thread only
+struct my_uart_uio_stats {
+    uint64_t loops;
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint64_t rx_dropped;   // rx ring full
+    uint64_t overruns;     // FIFO overflowed before the thread got there
+};
+
+struct my_uart_uio {
+    int fd;                // /dev/uioN
+    void *map;
+    size_t map_len;
+    volatile uint32_t *regs;
+    struct my_uart_uio_ring rx; // poll thread -> application
+    struct my_uart_uio_ring tx; // application -> poll thread
+    pthread_t thread;
+    atomic_bool stop;
+    struct my_uart_uio_stats stats;
+};
+
+// 0 or -errno. u is large (two rings); allocate it statically or on the heap.
+int my_uart_uio_open(struct my_uart_uio *u, const struct my_uart_uio_cfg *cfg);
+void my_uart_uio_close(struct my_uart_uio *u);
+
+// Never block: return what could be moved, possibly 0
+size_t my_uart_uio_read(struct my_uart_uio *u, void *buf, size_t len);
+size_t my_uart_uio_write(struct my_uart_uio *u, const void *buf, size_t len);
+
+#endif /* MY_UART3_UIO_H */